@@ -0,0 +1,36 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "reader.h"
+#include "native_compiler.h"
+
+using namespace bls;
+
+// traduce un layout in un sorgente C++, da compilare con bls_add_native_layout
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << intl::translate("REQUIRED_INPUT_BLS") << std::endl;
+        return 1;
+    }
+    try {
+        stack_depths depths;
+        auto code = compile_layout(layout_box_list(argv[1]), depths);
+        if (argc > 2) {
+            std::ofstream out(argv[2]);
+            if (!out) {
+                throw file_error(intl::translate("CANT_SAVE_FILE", argv[2]));
+            }
+            write_native_source(out, code);
+        } else {
+            write_native_source(std::cout, code);
+        }
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << intl::translate("UNKNOWN_ERROR") << std::endl;
+        return 1;
+    }
+    return 0;
+}
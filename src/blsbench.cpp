@@ -0,0 +1,106 @@
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+
+#include <cxxopts.hpp>
+
+#include "reader.h"
+#include "native_module.h"
+
+using namespace bls;
+
+// confronta i risultati dei due percorsi senza copiare le variabili, che vengono liberate alla lettura successiva
+static void write_variable(std::string &out, const variable &var) {
+    if (var.is_array()) {
+        out += '[';
+        for (const auto &item : var.as_array()) {
+            write_variable(out, item);
+            out += ',';
+        }
+        out += ']';
+    } else {
+        out += var.as_string();
+    }
+}
+
+static std::string values_to_string(const reader &my_reader) {
+    std::string out;
+    for (const auto &table : my_reader.get_values()) {
+        for (const auto &[key, var] : table) {
+            out += key;
+            out += '=';
+            write_variable(out, var);
+            out += '\n';
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+// tempo medio di una lettura in millisecondi
+static double time_reader(reader &my_reader, size_t iterations) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        my_reader.start();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv) {
+    std::filesystem::path input_bls;
+    std::filesystem::path native_path;
+    std::vector<std::filesystem::path> input_pdfs;
+    size_t iterations = 100;
+
+    try {
+        cxxopts::Options options(argv[0]);
+
+        options.add_options()
+            ("input-bls",       intl::translate("BLS_INPUT_FILE"),      cxxopts::value(input_bls))
+            ("native",          intl::translate("NATIVE_MODULE_FILE"),  cxxopts::value(native_path))
+            ("input-pdf",       intl::translate("PDF_INPUT_FILE"),      cxxopts::value(input_pdfs))
+            ("n,iterations",    intl::translate("ITERATIONS"),          cxxopts::value(iterations))
+        ;
+
+        options.positional_help("input-bls native input-pdf...");
+        options.parse_positional({"input-bls", "native", "input-pdf"});
+
+        auto results = options.parse(argc, argv);
+        if (!results.count("input-bls") || !results.count("native") || input_pdfs.empty()) {
+            std::cout << options.help() << std::endl;
+            return 1;
+        }
+
+        warm_up();
+
+        auto module = std::make_shared<const native_module>(native_path);
+
+        reader my_reader;
+        my_reader.add_layout(layout_box_list(input_bls));
+
+        std::cout << "file\tinterpreted_ms\tnative_ms\tspeedup\tsame_result\n";
+        for (const auto &pdf : input_pdfs) {
+            pdf_document my_doc(pdf);
+            my_reader.set_document(my_doc);
+
+            my_reader.set_native_module(nullptr);
+            double interpreted = time_reader(my_reader, iterations);
+            auto interpreted_values = values_to_string(my_reader);
+
+            if (!my_reader.set_native_module(module)) {
+                std::cerr << intl::translate("INVALID_NATIVE_MODULE", native_path.string()) << std::endl;
+                return 1;
+            }
+            double native = time_reader(my_reader, iterations);
+            auto native_values = values_to_string(my_reader);
+
+            std::cout << pdf.string() << '\t' << interpreted << '\t' << native << '\t'
+                << interpreted / native << '\t' << std::boolalpha << (interpreted_values == native_values) << '\n';
+        }
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,20 +1,53 @@
 #include <iostream>
 #include <filesystem>
+#include <map>
 
 #include "parser.h"
 #include "bytecode_printer.h"
 
 using namespace bls;
 
+// conta le coppie di istruzioni consecutive, per scegliere le superistruzioni
+static void print_opcode_pairs(const command_list &code) {
+    std::map<std::pair<opcode, opcode>, size_t> pairs;
+    std::optional<opcode> prev;
+    for (const command_args &line : code) {
+        switch (line.command()) {
+        case opcode::LABEL:
+            prev.reset();
+            [[fallthrough]];
+        case opcode::BOXNAME:
+        case opcode::COMMENT:
+            continue;
+        default:
+            if (prev) {
+                ++pairs[{*prev, line.command()}];
+            }
+            prev = line.command();
+        }
+    }
+
+    std::vector<std::pair<std::pair<opcode, opcode>, size_t>> sorted(pairs.begin(), pairs.end());
+    std::ranges::stable_sort(sorted, std::ranges::greater{}, [](const auto &pair) { return pair.second; });
+    for (const auto &[ops, count] : sorted) {
+        std::cout << count << '\t' << enums::to_string(ops.first) << ' ' << enums::to_string(ops.second) << '\n';
+    }
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         std::cerr << intl::translate("REQUIRED_INPUT_BLS") << std::endl;
         return 1;
     }
+    bool opcode_pairs = argc > 2 && std::string_view(argv[2]) == "--pairs";
     try {
         auto code = parser{}(layout_box_list(argv[1]));
-        for (auto it = code.begin(); it != code.end(); ++it) {
-            std::cout << bytecode_printer(code, it) << '\n';
+        if (opcode_pairs) {
+            print_opcode_pairs(code);
+        } else {
+            for (auto it = code.begin(); it != code.end(); ++it) {
+                std::cout << bytecode_printer(code, it) << '\n';
+            }
         }
     } catch (const std::exception &error) {
         std::cerr << error.what() << std::endl;
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <filesystem>
+
+#include <cxxopts.hpp>
+
+#include "reader.h"
+#include "layout_probe.h"
+
+using namespace bls;
+
+// Con --layout aggiunge i pdf come esempi del layout,
+// altrimenti cerca il layout di ogni pdf e stampa il risultato.
+// In entrambi i casi l'indice aggiornato viene salvato
+int main(int argc, char **argv) {
+    std::filesystem::path index_path;
+    std::filesystem::path layout_path;
+    std::vector<std::filesystem::path> input_pdfs;
+    size_t max_candidates = 4;
+
+    try {
+        cxxopts::Options options(argv[0]);
+
+        options.add_options()
+            ("index",               intl::translate("INDEX_FILE"),          cxxopts::value(index_path))
+            ("input-pdf",           intl::translate("PDF_INPUT_FILE"),      cxxopts::value(input_pdfs))
+            ("l,layout",            intl::translate("BLS_INPUT_FILE"),      cxxopts::value(layout_path))
+            ("k,max-candidates",    intl::translate("MAX_CANDIDATES"),      cxxopts::value(max_candidates))
+        ;
+
+        options.positional_help("index input-pdf...");
+        options.parse_positional({"index", "input-pdf"});
+
+        auto results = options.parse(argc, argv);
+        if (!results.count("index") || input_pdfs.empty()) {
+            std::cout << options.help() << std::endl;
+            return 1;
+        }
+
+        warm_up();
+
+        auto index = std::filesystem::exists(index_path) ? layout_index(index_path) : layout_index();
+
+        for (const auto &pdf : input_pdfs) {
+            pdf_document my_doc(pdf);
+            if (!layout_path.empty()) {
+                index.add_sample(layout_path, my_doc.get_page_text(pdf_rect{0.0, 0.0, 1.0, 1.0, 1}));
+            } else if (auto match = find_layout(my_doc, index, max_candidates)) {
+                std::cout << pdf.string() << '\t' << match->layout.string() << '\n';
+            } else {
+                std::cout << pdf.string() << '\t' << '\n';
+            }
+        }
+
+        index.save_file(index_path);
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
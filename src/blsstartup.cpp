@@ -0,0 +1,92 @@
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+
+#include <cxxopts.hpp>
+
+#include "utils/enums.h"
+#include "utils/translations.h"
+
+// Misura il tempo dal lancio di blsexec alla sua uscita, rilanciandolo a ogni prova
+// come farebbe chi lo chiama da riga di comando:
+// - help:  blsexec --help, esce prima di inizializzare i locale e poppler
+// - read:  blsexec layout -p pdf, legge il pdf e stampa il risultato
+
+DEFINE_ENUM(startup_mode,
+    (help)
+    (read)
+)
+
+static std::string quote(const std::string &str) {
+    return '"' + str + '"';
+}
+
+#ifdef _WIN32
+static constexpr std::string_view null_device = "NUL";
+#else
+static constexpr std::string_view null_device = "/dev/null";
+#endif
+
+int main(int argc, char **argv) {
+    std::filesystem::path input_bls;
+    std::filesystem::path input_pdf;
+    std::filesystem::path blsexec = std::filesystem::path(argv[0]).replace_filename("blsexec");
+    size_t iterations = 20;
+
+    try {
+        cxxopts::Options options(argv[0]);
+
+        options.add_options()
+            ("input-bls",       intl::translate("BLS_INPUT_FILE"),      cxxopts::value(input_bls))
+            ("input-pdf",       intl::translate("PDF_INPUT_FILE"),      cxxopts::value(input_pdf))
+            ("n,iterations",    intl::translate("ITERATIONS"),          cxxopts::value(iterations))
+            ("blsexec",         intl::translate("BLSEXEC_PATH"),        cxxopts::value(blsexec))
+        ;
+
+        options.positional_help("input-bls input-pdf");
+        options.parse_positional({"input-bls", "input-pdf"});
+
+        auto results = options.parse(argc, argv);
+        if (!results.count("input-bls") || !results.count("input-pdf")) {
+            std::cout << options.help() << std::endl;
+            return 1;
+        }
+
+        std::cout << "mode\tmean_ms\tmin_ms\n";
+        for (auto mode : enums::enum_values_v<startup_mode>) {
+            std::string command;
+            switch (mode) {
+            case startup_mode::help:
+                command = std::format("{} --help", quote(blsexec.string()));
+                break;
+            case startup_mode::read:
+                command = std::format("{} {} -p {}", quote(blsexec.string()),
+                    quote(input_bls.string()), quote(input_pdf.string()));
+                break;
+            }
+            // l'output di blsexec non interessa, viene misurato solo il tempo
+            auto redirected = std::format("{} > {}", command, null_device);
+
+            double total = 0.0;
+            double best = std::numeric_limits<double>::max();
+            for (size_t i = 0; i < iterations; ++i) {
+                auto begin = std::chrono::steady_clock::now();
+                if (std::system(redirected.c_str()) != 0) {
+                    std::cerr << command << std::endl;
+                    return 1;
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+                total += elapsed.count();
+                best = std::min(best, elapsed.count());
+            }
+
+            std::cout << enums::to_string(mode) << '\t' << total / iterations << '\t' << best << '\n';
+        }
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+
+#include <cxxopts.hpp>
+
+#include <TextOutputDev.h>
+
+#include "pdf_document.h"
+#include "glyph_output_dev.h"
+
+using namespace bls;
+
+// confronta l'estrazione del testo RAW con TextOutputDev e con glyph_output_dev,
+// leggendo ogni volta tutte le pagine senza passare dalla cache di pdf_document.
+// Confronta poi il testo letto da pdf_document: con -j deve essere uguale a quello letto senza thread
+// di estrazione, con set_raw_glyphs vengono contati i rettangoli RAW con il testo diverso
+
+template<typename Function>
+static double time_pages(PDFDoc &doc, size_t iterations, Function fun) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        for (int page = 1; page <= doc.getNumPages(); ++page) {
+            fun(page);
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / iterations;
+}
+
+// rettangoli letti nel confronto: le pagine intere e una griglia 2x2 su ogni pagina
+static std::vector<pdf_rect> compare_rects(int num_pages, std::initializer_list<read_mode> modes) {
+    std::vector<pdf_rect> rects;
+    for (int page = 1; page <= num_pages; ++page) {
+        for (auto mode : modes) {
+            rects.emplace_back(0.0, 0.0, 1.0, 1.0, page, mode);
+            for (double x : {0.0, 0.5}) {
+                for (double y : {0.0, 0.5}) {
+                    rects.emplace_back(x, y, 0.5, 0.5, page, mode);
+                }
+            }
+        }
+    }
+    return rects;
+}
+
+// ritorna il numero di letture diverse tra i due documenti, i rettangoli diversi vengono scritti su stderr
+static size_t count_differences(const pdf_document &lhs, const pdf_document &rhs, std::span<const pdf_rect> rects) {
+    size_t differences = 0;
+    for (const auto &rect : rects) {
+        if (lhs.get_text(rect) != rhs.get_text(rect)) {
+            std::cerr << std::format("{}: page {} ({}, {}, {}, {}) {}\n", lhs.filename().string(),
+                rect.page, rect.x, rect.y, rect.w, rect.h, enums::to_string(rect.mode));
+            ++differences;
+        }
+    }
+    return differences;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::filesystem::path> input_pdfs;
+    size_t iterations = 10;
+    size_t threads = 4;
+
+    try {
+        cxxopts::Options options(argv[0]);
+
+        options.add_options()
+            ("input-pdf",       intl::translate("PDF_INPUT_FILE"),      cxxopts::value(input_pdfs))
+            ("n,iterations",    intl::translate("ITERATIONS"),          cxxopts::value(iterations))
+            ("j,threads",       intl::translate("EXTRACT_THREADS"),     cxxopts::value(threads))
+        ;
+
+        options.positional_help("input-pdf...");
+        options.parse_positional({"input-pdf"});
+
+        options.parse(argc, argv);
+        if (input_pdfs.empty()) {
+            std::cout << options.help() << std::endl;
+            return 1;
+        }
+
+        pdf_document::init_poppler();
+
+        std::cout << "file\tpages\tglyphs\ttextoutputdev_ms\tglyph_ms\ttextoutputdev_glyphs_per_s\tglyph_glyphs_per_s\tspeedup\n";
+        for (const auto &pdf : input_pdfs) {
+            auto doc_ptr = [&] {
+                if constexpr (std::is_constructible_v<PDFDoc, std::unique_ptr<GooString> &&>) {
+                    return std::make_unique<PDFDoc>(std::make_unique<GooString>(pdf.string()));
+                } else {
+                    return std::make_unique<PDFDoc>(new GooString(pdf.string()));
+                }
+            }();
+            auto &doc = *doc_ptr;
+            if (!doc.isOk()) {
+                throw file_error(intl::translate("CANT_OPEN_FILE", pdf.string()));
+            }
+
+            size_t glyphs = 0;
+            for (int page = 1; page <= doc.getNumPages(); ++page) {
+                glyph_output_dev dev;
+                doc.displayPage(&dev, page, 72, 72, 0, false, true, false);
+                glyphs += dev.take_glyphs().size();
+            }
+
+            double textoutputdev = time_pages(doc, iterations, [&](int page) {
+                std::string text;
+                TextOutputDev td([](void *stream, const char *str, int len) {
+                    static_cast<std::string *>(stream)->append(str, len);
+                }, &text, false, 0, true, false);
+                td.setTextEOL(eolUnix);
+                td.setTextPageBreaks(false);
+                doc.displayPage(&td, page, 72, 72, 0, false, true, false);
+            });
+
+            double glyph = time_pages(doc, iterations, [&](int page) {
+                glyph_output_dev dev;
+                doc.displayPage(&dev, page, 72, 72, 0, false, true, false);
+                auto text = assemble_raw_text(dev.take_glyphs(), 0.0, 0.0,
+                    doc.getPageCropWidth(page), doc.getPageCropHeight(page));
+            });
+
+            std::cout << pdf.string() << '\t' << doc.getNumPages() << '\t' << glyphs << '\t'
+                << textoutputdev << '\t' << glyph << '\t'
+                << glyphs * 1000.0 / textoutputdev << '\t' << glyphs * 1000.0 / glyph << '\t'
+                << textoutputdev / glyph << '\n';
+        }
+
+        // il testo letto con -j deve essere identico, quello composto dai caratteri in modalita' RAW puo' differire
+        size_t threaded_differences = 0;
+        std::cout << "\nfile\treads\tthreaded_differences\traw_reads\traw_glyphs_differences\n";
+        for (const auto &pdf : input_pdfs) {
+            pdf_document serial(pdf);
+            pdf_document threaded(pdf, threads);
+            pdf_document raw_glyphs;
+            raw_glyphs.set_raw_glyphs(true);
+            raw_glyphs.open(pdf);
+
+            auto rects = compare_rects(serial.num_pages(), {read_mode::DEFAULT, read_mode::LAYOUT, read_mode::RAW});
+            auto raw_rects = compare_rects(serial.num_pages(), {read_mode::RAW});
+
+            size_t differences = count_differences(serial, threaded, rects);
+            std::cout << pdf.string() << '\t' << rects.size() << '\t' << differences << '\t'
+                << raw_rects.size() << '\t' << count_differences(serial, raw_glyphs, raw_rects) << '\n';
+            threaded_differences += differences;
+        }
+        if (threaded_differences != 0) {
+            return 1;
+        }
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
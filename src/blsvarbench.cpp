@@ -0,0 +1,178 @@
+#include <iostream>
+#include <chrono>
+#include <variant>
+#include <memory>
+#include <memory_resource>
+
+#include <cxxopts.hpp>
+
+#include "variable.h"
+
+using namespace bls;
+
+// Confronta variable con la disposizione precedente alla rappresentazione compatta:
+// la stringa posseduta allocata a parte e un variant grande abbastanza per un vettore.
+// Vengono riprodotte solo le operazioni misurate, con lo stesso comportamento di allora
+class legacy_variable {
+public:
+    legacy_variable() = default;
+
+    legacy_variable(int64_t value) : m_value(value) {}
+
+    legacy_variable(const std::string &value)
+        : m_str(std::make_unique<std::string>(value))
+        , m_value(string_state(*m_str)) {}
+
+    legacy_variable(const legacy_variable &other) {
+        *this = other;
+    }
+
+    legacy_variable(legacy_variable &&other) = default;
+
+    legacy_variable &operator = (const legacy_variable &other) {
+        if (auto *view = std::get_if<string_state>(&other.m_value); view && other.m_str) {
+            m_str = std::make_unique<std::string>(*view);
+            m_value = string_state(*m_str, view->flags);
+        } else {
+            m_str.reset();
+            m_value = other.m_value;
+        }
+        return *this;
+    }
+
+    legacy_variable &operator = (legacy_variable &&other) = default;
+
+    const legacy_variable &deref() const {
+        if (auto *ptr = std::get_if<const legacy_variable *>(&m_value)) {
+            return (*ptr)->deref();
+        }
+        return *this;
+    }
+
+    // come allora l'uguaglianza passa dal confronto a tre vie
+    bool operator == (const legacy_variable &other) const {
+        return 0 == std::visit(util::overloaded{
+            [](string_state lhs, string_state rhs) -> std::partial_ordering { return std::string_view(lhs) <=> std::string_view(rhs); },
+            [](int64_t lhs, int64_t rhs) -> std::partial_ordering { return lhs <=> rhs; },
+            [](const auto &, const auto &) { return std::partial_ordering::unordered; }
+        }, deref().m_value, other.deref().m_value);
+    }
+
+    legacy_variable operator + (const legacy_variable &rhs) const {
+        legacy_variable ret = *this;
+        if (!ret.m_str) {
+            ret.m_str = std::make_unique<std::string>(std::get<string_state>(ret.m_value));
+        }
+        ret.m_str->append(std::get<string_state>(rhs.m_value));
+        ret.m_value = string_state(*ret.m_str);
+        return ret;
+    }
+
+private:
+    std::unique_ptr<std::string> m_str;
+
+    std::variant<std::monostate, string_state, fixed_point, bool, int64_t, double, datetime,
+        std::vector<legacy_variable>, const legacy_variable *> m_value;
+};
+
+// impedisce al compilatore di eliminare le operazioni misurate
+static volatile size_t sink;
+
+template<typename Function>
+static double time_op(size_t iterations, Function fun) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        sink = sink + fun();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+template<typename T>
+static std::vector<T> make_values(std::string_view kind, size_t count) {
+    std::vector<T> values;
+    for (size_t i = 0; i < count; ++i) {
+        if (kind == "int") {
+            values.emplace_back(int64_t(i % 100));
+        } else if (kind == "short_string") {
+            values.emplace_back(std::format("s{}", i % 100));
+        } else {
+            values.emplace_back(std::format("una stringa piu' lunga di un registro {}", i % 100));
+        }
+    }
+    return values;
+}
+
+template<typename T>
+static double time_copy(const std::vector<T> &values, size_t iterations) {
+    return time_op(iterations, [&] {
+        std::vector<T> copy = values;
+        return copy.size();
+    });
+}
+
+template<typename T>
+static double time_compare(const std::vector<T> &values, size_t iterations) {
+    return time_op(iterations, [&] {
+        size_t equal = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            equal += values[i] == values[(i + 100) % values.size()];
+        }
+        return equal;
+    });
+}
+
+template<typename T>
+static double time_concat(const std::vector<T> &values, size_t iterations) {
+    return time_op(iterations, [&] {
+        size_t count = 0;
+        for (size_t i = 0; i + 1 < values.size(); ++i) {
+            T result = values[i] + values[i + 1];
+            ++count;
+        }
+        return count;
+    });
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 1000;
+    size_t count = 1000;
+
+    try {
+        cxxopts::Options options(argv[0]);
+
+        options.add_options()
+            ("n,iterations",    intl::translate("ITERATIONS"),          cxxopts::value(iterations))
+            ("c,count",         intl::translate("VALUE_COUNT"),         cxxopts::value(count))
+        ;
+
+        options.parse(argc, argv);
+
+        std::cout << "sizeof(variable) = " << sizeof(variable)
+            << ", sizeof(legacy_variable) = " << sizeof(legacy_variable) << '\n';
+
+        std::cout << "op\tvalues\tvariable_ms\tlegacy_ms\tspeedup\n";
+        auto print_row = [](std::string_view op, std::string_view kind, double compact, double legacy) {
+            std::cout << op << '\t' << kind << '\t' << compact << '\t' << legacy << '\t' << legacy / compact << '\n';
+        };
+
+        // le variabili vengono allocate nell'arena come durante la lettura di un layout
+        std::pmr::unsynchronized_pool_resource arena;
+        util::resource_scope arena_scope{&arena};
+
+        for (std::string_view kind : {"int", "short_string", "long_string"}) {
+            auto compact_values = make_values<variable>(kind, count);
+            auto legacy_values = make_values<legacy_variable>(kind, count);
+
+            print_row("copy", kind, time_copy(compact_values, iterations), time_copy(legacy_values, iterations));
+            print_row("compare", kind, time_compare(compact_values, iterations), time_compare(legacy_values, iterations));
+            if (kind != "int") {
+                print_row("concat", kind, time_concat(compact_values, iterations), time_concat(legacy_values, iterations));
+            }
+        }
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
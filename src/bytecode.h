@@ -2,6 +2,7 @@
 #define __BYTECODE_H__
 
 #include <list>
+#include <atomic>
 
 #include "pdf_document.h"
 #include "fixed_point.h"
@@ -9,9 +10,13 @@
 
 namespace bls {
     struct command_call : function_iterator {
-        command_call(function_iterator fun) : function_iterator(fun) {}
+        size_t numargs;
+
+        command_call(function_iterator fun, size_t numargs) : function_iterator(fun), numargs(numargs) {}
         command_call(std::string_view name) : function_iterator(function_lookup::find(name)) {
             assert(function_lookup::valid(*this));
+            assert((*this)->second.minargs == (*this)->second.maxargs);
+            numargs = (*this)->second.minargs;
         }
     };
 
@@ -29,7 +34,7 @@ namespace bls {
     )
 
     struct command_label {
-        static inline int count = 0;
+        static inline std::atomic<int> count = 0;
         int id;
         command_label() : id(count++) {}
     };
@@ -45,7 +50,7 @@ namespace bls {
         (LABEL, command_label)          // command label
         (BOXNAME, string_ptr)           // set box name
         (COMMENT, string_ptr)           // comment
-        (NEWBOX)                        // resetta current_box
+        (SETBOX, pdf_rect)              // rect -> current_box
         (MVBOX, spacer_index)           // stack -> current_box[index]
         (MVNBOX, spacer_index)          // -stack -> current_box[index]
         (RDBOX, read_mode)              // poppler.get_text(current_box) -> stack
@@ -68,6 +73,9 @@ namespace bls {
         (SUBITEM, size_t)               // stack.top = stack.top[index]
         (SUBITEMDYN)                    // stack -> stack.top = stack.top[stack]
         (PUSHVAR)                       // selected -> stack
+        (PUSHVARNAMED, string_ptr)      // name -> stack (current_table)
+        (PUSHGLOBALNAMED, string_ptr)   // name -> stack (globals)
+        (PUSHLOCALNAMED, string_ptr)    // name -> stack (calls.top.vars)
         (PUSHVIEW)                      // view_stack -> stack
         (PUSHNULL)                      // null -> stack
         (PUSHNUM, fixed_point)          // number -> stack
@@ -78,9 +86,13 @@ namespace bls {
         (PUSHREGEX, string_ptr)         // str -> stack (flag come regex)
         (STKAPP)                        // stack -> append to stack.top - 1
         (STKSWP)                        // swaps top 2 elements in stack
-        (CALLARGS, size_t)              // sets numargs
+        (STKPICK, size_t)               // stack[top - index] -> stack (copy)
+        (STKDROP, size_t)               // removes index elements under stack.top (deref)
         (CALL, command_call)            // stack * numargs -> fun_name -> stack
         (SYSCALL, command_call)         // stack * numargs -> fun_name
+        (ADDINT)                        // stack * 2 -> lhs + rhs -> stack (INTEGER)
+        (SUBINT)                        // stack * 2 -> lhs - rhs -> stack (INTEGER)
+        (MULINT)                        // stack * 2 -> lhs * rhs -> stack (INTEGER)
         (VIEWADD)                       // stack -> view_stack
         (VIEWADDLIST)                   // stack -> view_stack
         (VIEWPOP)                       // view_stack.pop()
@@ -88,9 +100,22 @@ namespace bls {
         (JMP, command_node)             // unconditional jump
         (JZ, command_node)              // stack -> jump if top == 0
         (JNZ, command_node)             // stack -> jump if top != 0
+        (JZEQ, command_node)            // stack * 2 -> jump if !(lhs == rhs)
+        (JZNEQ, command_node)           // stack * 2 -> jump if !(lhs != rhs)
+        (JZLT, command_node)            // stack * 2 -> jump if !(lhs < rhs)
+        (JZGT, command_node)            // stack * 2 -> jump if !(lhs > rhs)
+        (JZLEQ, command_node)           // stack * 2 -> jump if !(lhs <= rhs)
+        (JZGEQ, command_node)           // stack * 2 -> jump if !(lhs >= rhs)
+        (JZEQINT, command_node)         // stack * 2 -> jump if !(lhs == rhs) (INTEGER)
+        (JZNEQINT, command_node)        // stack * 2 -> jump if !(lhs != rhs) (INTEGER)
+        (JZLTINT, command_node)         // stack * 2 -> jump if !(lhs < rhs) (INTEGER)
+        (JZGTINT, command_node)         // stack * 2 -> jump if !(lhs > rhs) (INTEGER)
+        (JZLEQINT, command_node)        // stack * 2 -> jump if !(lhs <= rhs) (INTEGER)
+        (JZGEQINT, command_node)        // stack * 2 -> jump if !(lhs >= rhs) (INTEGER)
         (JVE, command_node)             // jump if view_stack.top at end
         (JSR, command_node)             // program_counter -> call_stack -- jump to subroutine and discard return value
         (JSRVAL, command_node)          // program_counter -> call_stack -- jump to subroutine
+        (MEMOLOOKUP, size_t)            // stack * numargs -> return if found in cache, otherwise save the key
         (MOVERVAL)                      // stack -> return value (move)
         (COPYRVAL)                      // stack -> return value (copy)
         (RET)                           // jump to call_stack.top
@@ -129,19 +154,25 @@ namespace bls {
 
     template<opcode Cmd> using command_tag = enums::enum_tag_t<Cmd>;
 
+    // chiama fun con gli argomenti di un comando di cui e' noto l'opcode
+    template<opcode Cmd, typename Command, typename Function>
+    requires std::same_as<std::remove_const_t<Command>, command_args>
+    decltype(auto) invoke_command(Function &&fun, Command &cmd) {
+        if constexpr (!enums::value_with_type<Cmd>) {
+            return std::invoke(fun, command_tag<Cmd>{});
+        } else if constexpr (std::is_same_v<enums::enum_type_t<Cmd>, string_ptr>) {
+            return std::invoke(fun, command_tag<Cmd>{}, *cmd.template get_args<Cmd>());
+        } else {
+            return std::invoke(fun, command_tag<Cmd>{}, cmd.template get_args<Cmd>());
+        }
+    }
+
     template<typename ReturnType, typename Command, typename Function>
     requires std::same_as<std::remove_const_t<Command>, command_args>
     ReturnType visit_command(Function &&fun, Command &cmd) {
         constexpr auto command_vtable = []<opcode ... Cmds>(enums::enum_sequence<Cmds ...>) {
             return std::array{ +[](Function &fun, Command &cmd) -> ReturnType {
-                constexpr opcode Cmd = Cmds;
-                if constexpr (!enums::value_with_type<Cmd>) {
-                    return std::invoke(fun, command_tag<Cmd>{});
-                } else if constexpr (std::is_same_v<enums::enum_type_t<Cmd>, string_ptr>) {
-                    return std::invoke(fun, command_tag<Cmd>{}, *cmd.template get_args<Cmd>());
-                } else {
-                    return std::invoke(fun, command_tag<Cmd>{}, cmd.template get_args<Cmd>());
-                }
+                return invoke_command<Cmds>(fun, cmd);
             } ... };
         } (enums::make_enum_sequence<opcode>());
 
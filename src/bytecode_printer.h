@@ -27,7 +27,20 @@ namespace {
         }
 
         std::ostream &operator()(bls::command_call call) {
-            return out << call->first;
+            out << call->first;
+            if (call->second.minargs != call->second.maxargs) {
+                out << ',' << call.numargs;
+            }
+            return out;
+        }
+
+        // i numeri vengono stampati con tutte le cifre, due layout con i rettangoli diversi hanno un hash diverso
+        std::ostream &operator()(double value) {
+            return out << std::format("{}", value);
+        }
+
+        std::ostream &operator()(const bls::pdf_rect &rect) {
+            return out << std::format("{} {} {} {} {}", rect.x, rect.y, rect.w, rect.h, rect.page);
         }
 
         std::ostream &operator()(bls::command_label label) {
@@ -47,9 +60,9 @@ namespace bls {
 
     struct bytecode_printer {
         const command_list &list;
-        command_node node;
+        command_list::const_iterator node;
 
-        bytecode_printer(const command_list &list, command_node node)
+        bytecode_printer(const command_list &list, command_list::const_iterator node)
             : list(list), node(node) {}
     };
 
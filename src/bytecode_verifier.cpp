@@ -0,0 +1,320 @@
+#include "bytecode_verifier.h"
+
+#include <map>
+#include <vector>
+#include <optional>
+
+#include "utils/translations.h"
+
+using namespace bls;
+
+namespace {
+
+    using command_iterator = command_list::const_iterator;
+
+    // profondita' degli stack relativa all'inizio della funzione,
+    // i valori sono negativi quando la funzione consuma gli argomenti del chiamante
+    struct stack_state {
+        ptrdiff_t values = 0;
+        ptrdiff_t views = 0;
+        ptrdiff_t selected = 0;
+
+        bool operator == (const stack_state &other) const = default;
+    };
+
+    // effetto di un comando sugli stack
+    struct command_effect {
+        ptrdiff_t pops = 0;
+        ptrdiff_t pushes = 0;
+        ptrdiff_t views = 0;
+        ptrdiff_t min_views = 0;
+        ptrdiff_t selected = 0;
+        ptrdiff_t min_selected = 0;
+    };
+
+    command_effect get_effect(const command_args &cmd) {
+        switch (cmd.command()) {
+        case opcode::RDBOX:
+        case opcode::RDPAGE:
+        case opcode::PUSHVARNAMED:
+        case opcode::PUSHGLOBALNAMED:
+        case opcode::PUSHLOCALNAMED:
+        case opcode::PUSHNULL:
+        case opcode::PUSHNUM:
+        case opcode::PUSHBOOL:
+        case opcode::PUSHINT:
+        case opcode::PUSHDOUBLE:
+        case opcode::PUSHSTR:
+        case opcode::PUSHREGEX:
+            return {.pushes = 1};
+        case opcode::PUSHVIEW:
+            return {.pushes = 1, .min_views = 1};
+        case opcode::MVBOX:
+        case opcode::MVNBOX:
+        case opcode::JZ:
+        case opcode::JNZ:
+        case opcode::MOVERVAL:
+        case opcode::COPYRVAL:
+            return {.pops = 1};
+        case opcode::SELVAR:
+        case opcode::SELGLOBAL:
+        case opcode::SELLOCAL:
+            return {.selected = 1};
+        case opcode::SELVARDYN:
+        case opcode::SELGLOBALDYN:
+        case opcode::SELLOCALDYN:
+            return {.pops = 1, .selected = 1};
+        case opcode::SELINDEX:
+        case opcode::SELAPPEND:
+            return {.min_selected = 1};
+        case opcode::SELINDEXDYN:
+            return {.pops = 1, .min_selected = 1};
+        case opcode::FWDVAR:
+        case opcode::SETVAR:
+        case opcode::FORCEVAR:
+        case opcode::INCVAR:
+        case opcode::DECVAR:
+            return {.pops = 1, .selected = -1, .min_selected = 1};
+        case opcode::CLEAR:
+            return {.selected = -1, .min_selected = 1};
+        case opcode::PUSHVAR:
+            return {.pushes = 1, .selected = -1, .min_selected = 1};
+        case opcode::SUBITEM:
+            return {.pops = 1, .pushes = 1};
+        case opcode::SUBITEMDYN:
+        case opcode::STKAPP:
+        case opcode::ADDINT:
+        case opcode::SUBINT:
+        case opcode::MULINT:
+            return {.pops = 2, .pushes = 1};
+        case opcode::STKSWP:
+            return {.pops = 2, .pushes = 2};
+        case opcode::STKPICK: {
+            ptrdiff_t idx = cmd.get_args<opcode::STKPICK>();
+            return {.pops = idx + 1, .pushes = idx + 2};
+        }
+        case opcode::STKDROP:
+            return {.pops = ptrdiff_t(cmd.get_args<opcode::STKDROP>()) + 1, .pushes = 1};
+        case opcode::CALL:
+            return {.pops = ptrdiff_t(cmd.get_args<opcode::CALL>().numargs), .pushes = 1};
+        case opcode::SYSCALL:
+            return {.pops = ptrdiff_t(cmd.get_args<opcode::SYSCALL>().numargs)};
+        case opcode::VIEWADD:
+        case opcode::VIEWADDLIST:
+            // il valore resta sullo stack finche' la vista non viene tolta
+            return {.pops = 1, .pushes = 1, .views = 1};
+        case opcode::VIEWPOP:
+            return {.pops = 1, .views = -1, .min_views = 1};
+        case opcode::VIEWNEXT:
+        case opcode::JVE:
+            return {.min_views = 1};
+        case opcode::JZEQ:
+        case opcode::JZNEQ:
+        case opcode::JZLT:
+        case opcode::JZGT:
+        case opcode::JZLEQ:
+        case opcode::JZGEQ:
+        case opcode::JZEQINT:
+        case opcode::JZNEQINT:
+        case opcode::JZLTINT:
+        case opcode::JZGTINT:
+        case opcode::JZLEQINT:
+        case opcode::JZGEQINT:
+            return {.pops = 2};
+        case opcode::MEMOLOOKUP: {
+            ptrdiff_t numargs = cmd.get_args<opcode::MEMOLOOKUP>();
+            return {.pops = numargs, .pushes = numargs};
+        }
+        default:
+            return {};
+        }
+    }
+
+    // riassunto di una funzione, usato nei punti in cui viene chiamata
+    struct function_summary {
+        bool visiting = false;
+
+        // valori lasciati sullo stack dal ritorno, nullopt finche' non si raggiunge un RET
+        std::optional<ptrdiff_t> ret_values;
+
+        // valori del chiamante letti dalla funzione
+        ptrdiff_t min_values = 0;
+
+        stack_state max;
+        ptrdiff_t max_calls = 0;
+    };
+
+    class bytecode_verifier {
+    public:
+        bytecode_verifier(const command_list &code) : m_code(code) {
+            for (auto it = code.begin(); it != code.end(); ++it) {
+                m_nodes.emplace(&*it, it);
+            }
+        }
+
+        stack_depths operator()() {
+            if (m_code.empty()) {
+                throw layout_error(intl::translate("INVALID_BYTECODE", enums::to_string(opcode::RET)));
+            }
+            const auto &main = analyze(m_code.begin());
+            if (main.min_values < 0 || main.ret_values != 0) {
+                invalid(m_code.front());
+            }
+            return {
+                .values = size_t(main.max.values),
+                .views = size_t(main.max.views),
+                .selected = size_t(main.max.selected),
+                .calls = size_t(main.max_calls) + 1
+            };
+        }
+
+    private:
+        using worklist = std::vector<std::pair<command_iterator, stack_state>>;
+
+        const function_summary &analyze(command_iterator entry);
+        void step(function_summary &fun, command_iterator it, stack_state state, worklist &next, worklist &pending);
+
+        [[noreturn]] void invalid(const command_args &cmd) const {
+            throw layout_error(intl::translate("INVALID_BYTECODE", enums::to_string(cmd.command())));
+        }
+
+        command_iterator jump_target(const command_args &cmd, command_node node) const {
+            auto it = m_nodes.find(&*node);
+            if (it == m_nodes.end()) invalid(cmd);
+            return it->second;
+        }
+
+        void set_return(function_summary &fun, const command_args &cmd, ptrdiff_t values) const {
+            if (fun.ret_values && *fun.ret_values != values) invalid(cmd);
+            fun.ret_values = values;
+        }
+
+    private:
+        const command_list &m_code;
+
+        std::map<const command_args *, command_iterator> m_nodes;
+        std::map<const command_args *, function_summary> m_functions;
+
+        // stato degli stack all'inizio di ogni comando della funzione che si sta analizzando
+        std::map<const command_args *, stack_state> m_states;
+    };
+
+    const function_summary &bytecode_verifier::analyze(command_iterator entry) {
+        auto &fun = m_functions[&*entry];
+        if (fun.visiting || fun.ret_values) return fun;
+        fun.visiting = true;
+
+        auto states = std::exchange(m_states, {});
+
+        worklist next{{entry, {}}};
+        worklist pending;
+        do {
+            // le chiamate ricorsive si possono seguire solo quando e' noto il ritorno
+            if (fun.ret_values) {
+                for (auto &[it, state] : std::exchange(pending, {})) {
+                    step(fun, it, state, next, pending);
+                }
+            }
+            while (!next.empty()) {
+                auto [it, state] = next.back();
+                next.pop_back();
+                auto [st, inserted] = m_states.try_emplace(&*it, state);
+                if (!inserted) {
+                    if (st->second != state) invalid(*it);
+                } else {
+                    step(fun, it, state, next, pending);
+                }
+            }
+        } while (!pending.empty() && fun.ret_values);
+
+        // la funzione non ritorna mai o chiama una funzione che non e' ancora stata verificata
+        if (!fun.ret_values || !pending.empty()) invalid(*entry);
+
+        m_states = std::move(states);
+        fun.visiting = false;
+        return fun;
+    }
+
+    void bytecode_verifier::step(function_summary &fun, command_iterator it, stack_state state, worklist &next, worklist &pending) {
+        const auto &cmd = *it;
+        auto effect = get_effect(cmd);
+        if (state.views < effect.min_views || state.selected < effect.min_selected) {
+            invalid(cmd);
+        }
+        state.values -= effect.pops;
+        fun.min_values = std::min(fun.min_values, state.values);
+        state.values += effect.pushes;
+        state.views += effect.views;
+        state.selected += effect.selected;
+
+        auto update_max = [&](const stack_state &depth) {
+            fun.max.values = std::max(fun.max.values, depth.values);
+            fun.max.views = std::max(fun.max.views, depth.views);
+            fun.max.selected = std::max(fun.max.selected, depth.selected);
+        };
+        update_max(state);
+
+        auto add_next = [&](command_iterator target, const stack_state &state) {
+            if (target == m_code.end()) invalid(cmd);
+            next.emplace_back(target, state);
+        };
+
+        auto add_call = [&](command_node node, ptrdiff_t retvalue) {
+            const auto &callee = analyze(jump_target(cmd, node));
+            if (!callee.ret_values) {
+                pending.emplace_back(it, state);
+                return;
+            }
+            fun.min_values = std::min(fun.min_values, state.values + callee.min_values);
+            update_max({
+                state.values + callee.max.values,
+                state.views + callee.max.views,
+                state.selected + callee.max.selected
+            });
+            fun.max_calls = std::max(fun.max_calls, callee.max_calls + 1);
+            add_next(std::next(it), {state.values + *callee.ret_values + retvalue, state.views, state.selected});
+        };
+
+        visit_command(util::overloaded{
+            [&]<opcode Cmd>(command_tag<Cmd>) {
+                add_next(std::next(it), state);
+            },
+            [&]<opcode Cmd>(command_tag<Cmd>, const auto &) {
+                add_next(std::next(it), state);
+            },
+            [&]<opcode Cmd>(command_tag<Cmd>, command_node node) {
+                // salti condizionali
+                add_next(std::next(it), state);
+                add_next(jump_target(cmd, node), state);
+            },
+            [&](command_tag<opcode::JMP>, command_node node) {
+                add_next(jump_target(cmd, node), state);
+            },
+            [&](command_tag<opcode::JSR>, command_node node) {
+                add_call(node, 0);
+            },
+            [&](command_tag<opcode::JSRVAL>, command_node node) {
+                add_call(node, 1);
+            },
+            [&](command_tag<opcode::MEMOLOOKUP>, size_t numargs) {
+                // se il risultato e' in cache la funzione ritorna subito
+                set_return(fun, cmd, state.values - ptrdiff_t(numargs));
+                add_next(std::next(it), state);
+            },
+            [&](command_tag<opcode::RET>) {
+                if (state.views != 0 || state.selected != 0) invalid(cmd);
+                set_return(fun, cmd, state.values);
+            },
+            [&](command_tag<opcode::IMPORT>, const std::string &) {
+                // il codice importato viene verificato quando viene caricato
+                fun.max_calls = std::max(fun.max_calls, ptrdiff_t(1));
+                add_next(std::next(it), state);
+            },
+        }, cmd);
+    }
+
+}
+
+stack_depths bls::verify_bytecode(const command_list &code) {
+    return bytecode_verifier{code}();
+}
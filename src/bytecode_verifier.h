@@ -0,0 +1,35 @@
+#ifndef __BYTECODE_VERIFIER_H__
+#define __BYTECODE_VERIFIER_H__
+
+#include <algorithm>
+
+#include "bytecode.h"
+
+namespace bls {
+
+    // profondita' massima raggiunta dagli stack del reader
+    struct stack_depths {
+        size_t values = 0;
+        size_t views = 0;
+        size_t selected = 0;
+        size_t calls = 0;
+
+        stack_depths &operator |= (const stack_depths &other) {
+            values = std::max(values, other.values);
+            views = std::max(views, other.views);
+            selected = std::max(selected, other.selected);
+            calls = std::max(calls, other.calls);
+            return *this;
+        }
+    };
+
+    // Segue tutti i percorsi del codice e di ogni funzione chiamata con JSR o JSRVAL,
+    // controllando che gli stack non vadano sotto zero e che siano bilanciati
+    // nei punti di incontro e al ritorno.
+    // Lancia layout_error se il bytecode non e' valido.
+    // Le chiamate ricorsive non aumentano la profondita' calcolata.
+    stack_depths verify_bytecode(const command_list &code);
+
+}
+
+#endif
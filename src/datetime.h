@@ -37,6 +37,9 @@ namespace bls {
 
         static datetime from_ymd(int year, int month, int day);
 
+        // locale usato per le date in formato ISO, inizializzato al primo utilizzo
+        static const std::locale &calendar_locale();
+
         void set_day(int day);
         void set_to_last_month_day();
         void add_years(int years);
@@ -0,0 +1,102 @@
+#include "document_snapshot.h"
+
+#include <fstream>
+
+using namespace bls;
+
+// il testo puo' contenere qualsiasi carattere, viene preceduto dalla sua lunghezza
+static constexpr std::string_view box_prefix = "### Box ";
+
+static std::string box_description(const pdf_rect &rect) {
+    return std::format("{} {} {} {} {} {}", rect.page, enums::to_string(rect.mode), rect.x, rect.y, rect.w, rect.h);
+}
+
+std::string recording_document::get_text(const pdf_rect &rect, const cancel_token &token) const {
+    auto text = m_doc.get_text(rect, token);
+    std::scoped_lock lock(m_mutex);
+    m_texts.emplace(rect, text);
+    return text;
+}
+
+void recording_document::save_file(const std::filesystem::path &filename) const {
+    std::ofstream output(filename, std::ios::binary);
+    if (!output) {
+        throw file_error(intl::translate("CANT_SAVE_FILE", filename.string()));
+    }
+
+    std::scoped_lock lock(m_mutex);
+
+    output << "### Snapshot\n";
+    output << "### File " << m_doc.filename().string() << '\n';
+    output << std::format("### Pages {}\n", m_doc.num_pages());
+    for (const auto &[rect, text] : m_texts) {
+        output << box_prefix << std::format("{} {}\n", box_description(rect), text.size());
+        output << text << '\n';
+    }
+    output << "### End Snapshot\n";
+}
+
+static std::string_view line_suffix(std::string_view line, std::string_view prefix) {
+    return util::string_trim(line.substr(prefix.size()));
+}
+
+static pdf_rect parse_box(std::string_view line, size_t &size) {
+    std::vector<std::string_view> fields;
+    for (auto field : util::string_split(line_suffix(line, box_prefix), ' ')) {
+        fields.push_back(field);
+    }
+    if (fields.size() != 7) {
+        throw parsing_error(intl::translate("INVALID_TOKEN", line));
+    }
+    auto mode = enums::from_string<read_mode>(fields[1]);
+    if (!mode) {
+        throw parsing_error(intl::translate("INVALID_TOKEN", line));
+    }
+    size = util::string_to<size_t>(fields[6]);
+    return pdf_rect{
+        util::string_to<double>(fields[2]), util::string_to<double>(fields[3]),
+        util::string_to<double>(fields[4]), util::string_to<double>(fields[5]),
+        util::string_to<int>(fields[0]), *mode
+    };
+}
+
+snapshot_document::snapshot_document(const std::filesystem::path &filename) {
+    std::ifstream input(filename, std::ios::binary);
+    if (!input) {
+        throw file_error(intl::translate("CANT_OPEN_FILE", filename.string()));
+    }
+
+    std::string line;
+    while (std::getline(input, line)) {
+        std::erase(line, '\r');
+        if (line.empty()) continue;
+
+        if (line == "### Snapshot") {
+            continue;
+        } else if (line.starts_with("### File ")) {
+            m_filename = line_suffix(line, "### File ");
+        } else if (line.starts_with("### Pages ")) {
+            m_num_pages = util::string_to<int>(line_suffix(line, "### Pages "));
+        } else if (line.starts_with(box_prefix)) {
+            size_t size;
+            auto rect = parse_box(line, size);
+            std::string text(size, '\0');
+            if (!input.read(text.data(), size) || input.get() != '\n') {
+                throw parsing_error(intl::translate("INVALID_TOKEN", line));
+            }
+            m_texts.emplace(rect, std::move(text));
+        } else if (line == "### End Snapshot") {
+            break;
+        } else {
+            throw parsing_error(intl::translate("INVALID_TOKEN", line));
+        }
+    }
+}
+
+std::string snapshot_document::get_text(const pdf_rect &rect, const cancel_token &) const {
+    auto it = m_texts.find(rect);
+    if (it == m_texts.end()) {
+        throw layout_error(intl::translate("BOX_NOT_IN_SNAPSHOT", box_description(rect)));
+    }
+    return it->second;
+}
@@ -0,0 +1,67 @@
+#ifndef __DOCUMENT_SNAPSHOT_H__
+#define __DOCUMENT_SNAPSHOT_H__
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+#include "pdf_document.h"
+
+namespace bls {
+
+    // inoltra le letture a un altro documento e salva i rettangoli letti con il loro testo
+    class recording_document : public document_source {
+    public:
+        explicit recording_document(const document_source &doc) : m_doc(doc) {}
+
+        std::filesystem::path filename() const override {
+            return m_doc.filename();
+        }
+
+        int num_pages() const override {
+            return m_doc.num_pages();
+        }
+
+        std::string get_text(const pdf_rect &rect, const cancel_token &token = {}) const override;
+
+        // le letture anticipate non vengono registrate finche' il reader non le usa
+        void prefetch(std::span<const pdf_rect> rects) const override {
+            m_doc.prefetch(rects);
+        }
+
+        // salva il nome del file, il numero di pagine e il testo letto, da riaprire con snapshot_document
+        void save_file(const std::filesystem::path &filename) const;
+
+    private:
+        const document_source &m_doc;
+
+        mutable std::mutex m_mutex;
+        mutable std::map<pdf_rect, std::string> m_texts;
+    };
+
+    // Documento registrato da recording_document, il pdf non viene aperto.
+    // La lettura di un rettangolo non registrato lancia layout_error:
+    // il layout e' cambiato e legge parti del documento che non sono nella registrazione
+    class snapshot_document : public document_source {
+    public:
+        explicit snapshot_document(const std::filesystem::path &filename);
+
+        std::filesystem::path filename() const override {
+            return m_filename;
+        }
+
+        int num_pages() const override {
+            return m_num_pages;
+        }
+
+        std::string get_text(const pdf_rect &rect, const cancel_token &token = {}) const override;
+
+    private:
+        std::filesystem::path m_filename;
+        int m_num_pages = 0;
+        std::map<pdf_rect, std::string> m_texts;
+    };
+
+}
+
+#endif
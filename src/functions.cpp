@@ -32,7 +32,7 @@ namespace bls {
 
         variable operator()(const variable &var) const {
             if (var.is_null() || var.is_number()) return var;
-            return (*this)(var.as_view());
+            return (*this)(std::string_view(var.as_string()));
         }
 
         variable operator()(const std::csub_match &m) const {
@@ -144,7 +144,12 @@ namespace bls {
     }
 
     // converte ogni carattere di spazio in " " e elimina gli spazi ripetuti
-    static std::string string_singleline(std::string_view str) {
+    static variable string_singleline(std::string_view str) {
+        // se non ci sono spazi da modificare ritorna una sottostringa senza copiarla
+        if (std::ranges::none_of(str, [](char ch) { return ch != ' ' && isspace(ch); })
+            && str.find("  ") == std::string_view::npos) {
+            return str;
+        }
         std::string ret;
         auto in_range = str | std::views::transform([](char ch) {
             return isspace(ch) ? ' ' : ch;
@@ -220,7 +225,7 @@ namespace bls {
             if (idx.size() == 2) {
                 size_t begin = idx[0];
                 if (begin < row.size()) {
-                    return std::string(row.substr(begin, idx[1]));
+                    return row.substr(begin, idx[1]);
                 }
             }
             return {};
@@ -444,7 +449,7 @@ namespace bls {
         }},
         {"search", [](std::string_view str, std::string_view regex, optional_size<1> index) -> variable {
             if (auto res = search_regex(str, create_regex(regex), index); !res.empty()) {
-                return std::string(res);
+                return res;
             } else {
                 return {};
             }
@@ -460,7 +465,7 @@ namespace bls {
         }},
         {"matches", [](std::string_view str, std::string_view regex_str, optional_size<1> index) -> variable {
             auto regex = create_regex(regex_str);
-            return search_regex_matches(str, regex, index) | std::views::transform(&std::csub_match::str);
+            return search_regex_matches(str, regex, index) | std::views::transform(match_to_view);
         }},
         {"matches_num", [](const reader *ctx, std::string_view str, std::string_view regex_str, optional_size<1> index) -> variable {
             auto regex = create_number_regex(ctx->m_locale, regex_str);
@@ -471,7 +476,7 @@ namespace bls {
             auto match = search_regex_captures(str, create_regex(regex_str));
             return match
                 | std::views::drop(1)
-                | std::views::transform(&std::csub_match::str);
+                | std::views::transform(match_to_view);
         }},
         {"captures_num", [](const reader *ctx, std::string_view str, std::string_view regex_str) -> variable {
             auto match = search_regex_captures(str, create_number_regex(ctx->m_locale, regex_str));
@@ -556,7 +561,7 @@ namespace bls {
             return string_find_icase(str, str2, 0).begin() != str.end();
         }},
         {"substr", [](std::string_view str, size_t pos, optional_size<std::string_view::npos> count) {
-            return std::string(str.substr(std::min(str.size(), pos), count));
+            return str.substr(std::min(str.size(), pos), count);
         }},
         {"between", [](std::string_view str, string_state from, optional<string_state> to) {
             return string_between<false, false>(str, from, to);
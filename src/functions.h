@@ -11,37 +11,43 @@ namespace bls {
 
     template<typename T> struct variable_converter {};
 
-    template<> struct variable_converter<variable> {
+    // i valori che non sono stringhe vengono convertiti in testo salvato in storage,
+    // che resta valido fino alla fine della chiamata alla funzione
+    struct converter_base {
+        string_storage *storage = nullptr;
+    };
+
+    template<> struct variable_converter<variable> : converter_base {
         const variable &operator()(const variable &var) const { return var.deref(); }
     };
-    template<> struct variable_converter<std::string> {
-        const std::string &operator()(const variable &var) const { return var.as_string(); }
+    template<> struct variable_converter<std::string> : converter_base {
+        std::string operator()(const variable &var) const { return var.as_string(); }
     };
-    template<> struct variable_converter<fixed_point> {
+    template<> struct variable_converter<fixed_point> : converter_base {
         fixed_point operator()(const variable &var) const { return var.as_number(); }
     };
-    template<> struct variable_converter<datetime> {
+    template<> struct variable_converter<datetime> : converter_base {
         datetime operator()(const variable &var) const { return var.as_date(); }
     };
-    template<> struct variable_converter<bool> {
+    template<> struct variable_converter<bool> : converter_base {
         bool operator()(const variable &var) const { return var.is_true(); }
     };
-    template<typename T> requires std::derived_from<string_state, T> struct variable_converter<T> {
-        T operator()(const variable &var) const { return var.as_view(); }
+    template<typename T> requires std::derived_from<string_state, T> struct variable_converter<T> : converter_base {
+        T operator()(const variable &var) const { return var.as_view(*storage); }
     };
-    template<std::integral T> struct variable_converter<T> {
+    template<std::integral T> struct variable_converter<T> : converter_base {
         T operator()(const variable &var) const { return var.as_int(); }
     };
-    template<std::floating_point T> struct variable_converter<T> {
+    template<std::floating_point T> struct variable_converter<T> : converter_base {
         T operator()(const variable &var) const { return var.as_double(); }
     };
 
     template<typename T> using vector_view = std::ranges::transform_view<std::span<const variable>, variable_converter<T>>;
 
-    template<typename T> struct variable_converter<vector_view<T>> {
+    template<typename T> struct variable_converter<vector_view<T>> : converter_base {
         vector_view<T> operator()(const variable &var) const {
             if (!var.is_array()) return {};
-            return std::ranges::transform_view(std::span{var.as_array()}, variable_converter<T>{});
+            return std::ranges::transform_view(std::span{var.as_array()}, variable_converter<T>{{storage}});
         }
     };
 
@@ -59,13 +65,13 @@ namespace bls {
     template<int Value>     using optional_int =    optional<int,    std::integral_constant<int, Value>>;
     template<size_t Value>  using optional_size =   optional<size_t, std::integral_constant<size_t, Value>>;
 
-    using arg_list = std::ranges::subrange<typename util::simple_stack<variable>::const_iterator>;
+    using arg_list = std::span<const variable>;
     
     template<typename T> using varargs_base = std::ranges::transform_view<arg_list, variable_converter<T>>;
     template<typename T, size_t Minargs = 0> struct varargs : varargs_base<T> {
         using var_type = T;
         template<std::ranges::input_range U> requires std::ranges::view<U>
-        varargs(U &&obj) : varargs_base<T>(std::forward<U>(obj), variable_converter<T>{}) {}
+        varargs(U &&obj, variable_converter<T> converter) : varargs_base<T>(std::forward<U>(obj), std::move(converter)) {}
     };
 
     template<typename T> concept argument_type = requires(const variable &var) {
@@ -162,27 +168,27 @@ namespace bls {
 
     template<typename T> struct argument_getter{};
     template<argument_type T> struct argument_getter<T> {
-        decltype(auto) operator()(arg_list &args, size_t index) const {
-            return variable_converter<T>{}(args[index]);
+        decltype(auto) operator()(arg_list &args, size_t index, string_storage &storage) const {
+            return variable_converter<T>{{&storage}}(args[index]);
         }
     };
     template<argument_type T, typename DefValue> struct argument_getter<optional<T, DefValue>> {
-        optional<T, DefValue> operator()(arg_list &args, size_t index) const {
+        optional<T, DefValue> operator()(arg_list &args, size_t index, string_storage &storage) const {
             if (index >= args.size()) {
                 return {DefValue::value};
             } else {
-                return {variable_converter<T>{}(args[index])};
+                return {variable_converter<T>{{&storage}}(args[index])};
             }
         }
     };
     template<argument_type T, size_t Minargs> struct argument_getter<varargs<T, Minargs>> {
-        varargs<T, Minargs> operator()(arg_list &args, size_t index) const {
-            return arg_list(args.begin() + index, args.end());
+        varargs<T, Minargs> operator()(arg_list &args, size_t index, string_storage &storage) const {
+            return {arg_list(args.begin() + index, args.end()), variable_converter<T>{{&storage}}};
         }
     };
 
-    template<typename TList, size_t I> static decltype(auto) get_arg(arg_list &args) {
-        return argument_getter<util::get_nth_t<I, TList>>{}(args, I);
+    template<typename TList, size_t I> static decltype(auto) get_arg(arg_list &args, string_storage &storage) {
+        return argument_getter<util::get_nth_t<I, TList>>{}(args, I, storage);
     }
 
     // rappresenta una closure che passa automaticamente gli argomenti
@@ -193,17 +199,23 @@ namespace bls {
 
         template<typename Function> static variable call_function(class reader *ctx, arg_list args) {
             using types = function_arg_types_t<Function>;
-            constexpr auto fun = [] <size_t ... Is> (class reader *ctx, arg_list &args, std::index_sequence<Is...>) {
+            constexpr auto fun = [] <size_t ... Is> (class reader *ctx, arg_list &args, string_storage &storage, std::index_sequence<Is...>) {
                 if constexpr (function_has_context_v<Function>) {
-                    return Function{}(ctx, get_arg<types, Is>(args) ...);
+                    return Function{}(ctx, get_arg<types, Is>(args, storage) ...);
                 } else {
-                    return Function{}(get_arg<types, Is>(args) ...);
+                    return Function{}(get_arg<types, Is>(args, storage) ...);
                 }
             };
+            string_storage storage;
             if constexpr (!std::is_void_v<function_return_type_t<Function>>) {
-                return fun(ctx, args, std::make_index_sequence<types::size>{});
+                variable ret = fun(ctx, args, storage, std::make_index_sequence<types::size>{});
+                // il risultato puo' puntare al testo convertito, che viene distrutto all'uscita
+                for (const auto &str : storage) {
+                    ret.detach_from_text(str);
+                }
+                return ret;
             } else {
-                fun(ctx, args, std::make_index_sequence<types::size>{});
+                fun(ctx, args, storage, std::make_index_sequence<types::size>{});
                 return {};
             }
         }
@@ -212,6 +224,7 @@ namespace bls {
         const size_t minargs;
         const size_t maxargs;
         const bool returns_value;
+        const bool has_context;
 
         template<typename Function>
         function_handler(Function)
@@ -219,6 +232,7 @@ namespace bls {
             , minargs(function_minargs_v<Function>)
             , maxargs(function_maxargs_v<Function>)
             , returns_value(!std::is_void_v<function_return_type_t<Function>>)
+            , has_context(function_has_context_v<Function>)
         { static_assert(valid_function<Function>); }
 
         variable operator()(class reader *ctx, arg_list args) const {
@@ -0,0 +1,62 @@
+#include "glyph_output_dev.h"
+
+#include <cmath>
+
+#include <GfxState.h>
+
+#include "utils/unicode.h"
+
+using namespace bls;
+
+void glyph_output_dev::drawChar(GfxState *state, double x, double y, double dx, double dy,
+    double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen)
+{
+    if (uLen <= 0) return;
+
+    double x1, y1, w1, h1;
+    state->transform(x, y, &x1, &y1);
+    state->transformDelta(dx, dy, &w1, &h1);
+    float size = state->getTransformedFontSize();
+
+    // le legature vengono divise in parti uguali
+    float width = std::abs(w1) / uLen;
+    for (int i = 0; i < uLen; ++i) {
+        m_glyphs.push_back({float(x1 + width * i), float(y1), width, size, char32_t(u[i])});
+    }
+}
+
+static bool is_space(char32_t code) {
+    return code == U' ' || code == U'\t' || code == U'\u00a0';
+}
+
+std::string bls::assemble_raw_text(std::span<const glyph> glyphs, double x0, double y0, double x1, double y1) {
+    std::string ret;
+    const glyph *last = nullptr;
+    bool pending_space = false;
+    for (const auto &g : glyphs) {
+        double center_x = g.x + g.width * 0.5;
+        double center_y = g.y - g.size * 0.5;
+        if (center_x < x0 || center_x > x1 || center_y < y0 || center_y > y1) continue;
+
+        if (is_space(g.code)) {
+            pending_space = last != nullptr;
+            continue;
+        }
+        if (last) {
+            float tolerance = std::max(last->size, g.size);
+            float gap = g.x - (last->x + last->width);
+            if (std::abs(g.y - last->y) > tolerance * 0.5f || gap < -tolerance) {
+                ret += '\n';
+            } else if (pending_space || gap > tolerance * 0.1f) {
+                ret += ' ';
+            }
+        }
+        ret += unicode::codePointToUTF8(g.code);
+        last = &g;
+        pending_space = false;
+    }
+    if (last) {
+        ret += '\n';
+    }
+    return ret;
+}
@@ -0,0 +1,47 @@
+#ifndef __GLYPH_OUTPUT_DEV_H__
+#define __GLYPH_OUTPUT_DEV_H__
+
+#include <vector>
+#include <string>
+#include <span>
+
+#include <OutputDev.h>
+
+namespace bls {
+
+    // carattere disegnato sulla pagina, in punti dall'angolo in alto a sinistra
+    struct glyph {
+        float x;        // inizio del carattere
+        float y;        // linea di base
+        float width;
+        float size;     // dimensione del font
+        char32_t code;
+    };
+
+    // OutputDev che registra solo i caratteri nell'ordine del content stream,
+    // senza l'analisi delle colonne e dell'ordine di lettura di TextOutputDev
+    class glyph_output_dev : public OutputDev {
+    public:
+        bool upsideDown() override { return true; }
+        bool useDrawChar() override { return true; }
+        bool interpretType3Chars() override { return false; }
+        bool needNonText() override { return false; }
+
+        void drawChar(GfxState *state, double x, double y, double dx, double dy,
+            double originX, double originY, CharCode code, int nBytes, const Unicode *u, int uLen) override;
+
+        std::vector<glyph> take_glyphs() {
+            return std::move(m_glyphs);
+        }
+
+    private:
+        std::vector<glyph> m_glyphs;
+    };
+
+    // Ricostruisce il testo dei caratteri con il centro dentro il rettangolo (in punti), nell'ordine in cui sono stati disegnati.
+    // Va a capo quando cambia la linea di base o si torna indietro, aggiunge uno spazio tra le parole distanti
+    std::string assemble_raw_text(std::span<const glyph> glyphs, double x0, double y0, double x1, double y1);
+
+}
+
+#endif
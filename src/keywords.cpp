@@ -2,6 +2,153 @@
 
 using namespace bls;
 
+// numero massimo di istruzioni di una funzione da espandere nel punto di chiamata
+static constexpr size_t max_inline_size = 24;
+
+// Restituisce il corpo della funzione da espandere nel punto di chiamata, se e' nella forma
+// SELLOCAL * n, FWDVAR * n, espressione, MOVERVAL|COPYRVAL, RET
+// e l'espressione non contiene cicli, chiamate a subroutine o assegnamenti.
+// Gli argomenti vengono letti direttamente dallo stack con STKPICK
+static std::vector<command_args> make_inline_code(command_node begin, command_node end) {
+    std::vector<command_args> ret;
+
+    auto next_line = [&]() -> command_args * {
+        for (; begin != end; ++begin) {
+            if (begin->command() != opcode::COMMENT) {
+                return &*(begin++);
+            }
+        }
+        return nullptr;
+    };
+
+    auto *line = next_line();
+    std::vector<std::string_view> args;
+    for (; line && line->command() == opcode::SELLOCAL; line = next_line()) {
+        args.push_back(*line->get_args<opcode::SELLOCAL>());
+    }
+    for (size_t i = 0; i < args.size(); ++i, line = next_line()) {
+        if (!line || line->command() != opcode::FWDVAR) return {};
+    }
+
+    auto jump_target = [](const command_args &cmd) {
+        return visit_command<const command_args *>(util::overloaded{
+            []<opcode Cmd>(command_tag<Cmd>) -> const command_args * { return nullptr; },
+            []<opcode Cmd>(command_tag<Cmd>, const auto &) -> const command_args * { return nullptr; },
+            []<opcode Cmd>(command_tag<Cmd>, const command_node &node) -> const command_args * { return &*node; }
+        }, cmd);
+    };
+
+    // profondita' dello stack sopra gli argomenti, per ogni label
+    std::map<int, size_t> label_depths;
+    std::set<int> added_labels;
+    size_t depth = 0;
+    bool reachable = true;
+
+    for (; line && line->command() != opcode::MOVERVAL && line->command() != opcode::COPYRVAL; line = next_line()) {
+        if (ret.size() >= max_inline_size) return {};
+        if (!reachable && line->command() != opcode::LABEL) return {};
+
+        command_args new_line = *line;
+        size_t pops = 0;
+        size_t pushes = 0;
+        switch (line->command()) {
+        case opcode::LABEL: {
+            int id = line->get_args<opcode::LABEL>().id;
+            auto it = label_depths.find(id);
+            if (!reachable) {
+                if (it == label_depths.end()) return {};
+                depth = it->second;
+                reachable = true;
+            } else if (it != label_depths.end() && it->second != depth) {
+                return {};
+            }
+            added_labels.insert(id);
+            break;
+        }
+        case opcode::PUSHLOCALNAMED: {
+            auto it = std::ranges::find(args, *line->get_args<opcode::PUSHLOCALNAMED>());
+            if (it == args.end()) return {};
+            new_line = make_command<opcode::STKPICK>(depth + (args.end() - it) - 1);
+            pushes = 1;
+            break;
+        }
+        case opcode::PUSHNULL:
+        case opcode::PUSHNUM:
+        case opcode::PUSHBOOL:
+        case opcode::PUSHINT:
+        case opcode::PUSHDOUBLE:
+        case opcode::PUSHSTR:
+        case opcode::PUSHREGEX:
+        case opcode::PUSHVARNAMED:
+        case opcode::PUSHGLOBALNAMED:
+        case opcode::PUSHVAR:
+        case opcode::STKPICK:
+            pushes = 1;
+            break;
+        case opcode::SELVAR:
+        case opcode::SELGLOBAL:
+        case opcode::SELINDEX:
+        case opcode::JMP:
+            break;
+        case opcode::SUBITEM:
+            pops = pushes = 1;
+            break;
+        case opcode::SUBITEMDYN:
+        case opcode::STKAPP:
+            pops = 2;
+            pushes = 1;
+            break;
+        case opcode::SELVARDYN:
+        case opcode::SELGLOBALDYN:
+        case opcode::SELINDEXDYN:
+        case opcode::JZ:
+        case opcode::JNZ:
+            pops = 1;
+            break;
+        case opcode::JZEQ:
+        case opcode::JZNEQ:
+        case opcode::JZLT:
+        case opcode::JZGT:
+        case opcode::JZLEQ:
+        case opcode::JZGEQ:
+            pops = 2;
+            break;
+        case opcode::STKDROP:
+            pops = line->get_args<opcode::STKDROP>() + 1;
+            pushes = 1;
+            break;
+        case opcode::CALL:
+            pops = line->get_args<opcode::CALL>().numargs;
+            pushes = 1;
+            break;
+        default:
+            return {};
+        }
+
+        if (depth < pops) return {};
+        depth = depth - pops + pushes;
+
+        if (auto *target = jump_target(*line)) {
+            // sono ammessi solo salti in avanti
+            int id = target->get_args<opcode::LABEL>().id;
+            if (added_labels.contains(id)) return {};
+            if (auto [it, inserted] = label_depths.emplace(id, depth); !inserted && it->second != depth) return {};
+        }
+        if (line->command() == opcode::JMP) {
+            reachable = false;
+        }
+        ret.push_back(std::move(new_line));
+    }
+
+    if (!line || !reachable || depth != 1) return {};
+    line = next_line();
+    if (!line || line->command() != opcode::RET || next_line()) return {};
+    for (const auto &[id, _] : label_depths) {
+        if (!added_labels.contains(id)) return {};
+    }
+    return ret;
+}
+
 void parser::parse_if_stmt() {
     m_lexer.require(token_type::KW_IF);
 
@@ -11,11 +158,7 @@ void parser::parse_if_stmt() {
     m_lexer.require(token_type::PAREN_BEGIN);
     read_expression();
     m_lexer.require(token_type::PAREN_END);
-    if (auto &last = m_code.last_not_comment(); last.command() == opcode::CALL && last.get_args<opcode::CALL>()->first == "not") {
-        last = make_command<opcode::JNZ>(else_label);
-    } else {
-        m_code.add_line<opcode::JZ>(else_label);
-    }
+    m_code.add_jz(else_label);
     read_statement();
     if (m_lexer.check_next(token_type::KW_ELSE)) {
         m_code.add_line<opcode::JMP>(endif_label);
@@ -36,7 +179,7 @@ void parser::parse_while_stmt() {
     m_lexer.require(token_type::PAREN_BEGIN);
     m_code.add_label(while_label);
     read_expression();
-    m_code.add_line<opcode::JZ>(endwhile_label);
+    m_code.add_jz(endwhile_label);
     m_lexer.require(token_type::PAREN_END);
     read_statement();
     m_code.add_line<opcode::JMP>(while_label);
@@ -58,7 +201,7 @@ void parser::parse_for_stmt() {
     m_code.add_label(for_label);
     if (!m_lexer.check_next(token_type::SEMICOLON)) {
         read_expression();
-        m_code.add_line<opcode::JZ>(endfor_label);
+        m_code.add_jz(endfor_label);
         m_lexer.require(token_type::SEMICOLON);
     }
     auto increase_stmt_begin = std::prev(m_code.end());
@@ -142,8 +285,8 @@ void parser::parse_function_stmt() {
         }
     }
 
-    m_functions.emplace(std::string(name.value), function_info{fun_label, args.size() + m_views_size});
-    for (auto _ : args) {
+    m_functions.emplace(std::string(name.value), function_info{fun_label, args.size() + m_views_size, {}, false});
+    for (size_t i = 0; i < args.size(); ++i) {
         m_code.add_line<opcode::FWDVAR>();
     }
     if (m_views_size > 0) {
@@ -157,10 +300,70 @@ void parser::parse_function_stmt() {
         }
         m_code.add_line<opcode::RET>();
     }
+    auto &fun = m_functions.find(name.value)->second;
+    if (m_views_size == 0) {
+        fun.inline_code = make_inline_code(std::next(fun_label), m_code.end());
+    }
+    fun.pure = is_pure_function(fun_label, m_code.end());
+    if (fun.pure && fun.inline_code.empty()) {
+        m_code.insert(std::next(fun_label), make_command<opcode::MEMOLOOKUP>(fun.numargs));
+    }
     m_code.add_label(endfun_label);
     m_views_size = old_views_size;
 };
 
+// funzioni di libreria che usano il contesto solo per il locale,
+// la cache dei risultati viene svuotata quando cambia
+static constexpr std::string_view locale_functions[] {
+    "num", "nums", "neg", "number_regex", "search_num", "matches_num", "captures_num",
+    "date", "search_date", "search_month", "date_format", "tolower", "toupper", "totitle"
+};
+
+bool parser::is_pure_function(command_node begin, command_node end) const {
+    for (auto it = std::next(begin); it != end; ++it) {
+        switch (it->command()) {
+        case opcode::SETBOX:
+        case opcode::MVBOX:
+        case opcode::MVNBOX:
+        case opcode::RDBOX:
+        case opcode::RDPAGE:
+        case opcode::SELVAR:
+        case opcode::SELVARDYN:
+        case opcode::SELGLOBAL:
+        case opcode::SELGLOBALDYN:
+        case opcode::PUSHVARNAMED:
+        case opcode::PUSHGLOBALNAMED:
+        case opcode::SYSCALL:
+        case opcode::IMPORT:
+        case opcode::SETPATH:
+        case opcode::SETLANG:
+        case opcode::FOUNDLAYOUT:
+            return false;
+        case opcode::CALL: {
+            const auto &call = it->get_args<opcode::CALL>();
+            if (call->second.has_context && std::ranges::find(locale_functions, call->first) == std::end(locale_functions)) {
+                return false;
+            }
+            break;
+        }
+        case opcode::JSR:
+        case opcode::JSRVAL: {
+            // le chiamate ricorsive sono ammesse
+            auto node = it->command() == opcode::JSR ? it->get_args<opcode::JSR>() : it->get_args<opcode::JSRVAL>();
+            if (node != begin && std::ranges::none_of(m_functions, [&](const auto &pair) {
+                return pair.second.node == node && pair.second.pure;
+            })) {
+                return false;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
 void parser::parse_foreach_stmt() {
     m_lexer.require(token_type::KW_FOREACH);
 
@@ -240,6 +443,9 @@ void parser::parse_return_stmt() {
 
         switch (m_code.last_not_comment().command()) {
         case opcode::PUSHVAR:
+        case opcode::PUSHVARNAMED:
+        case opcode::PUSHGLOBALNAMED:
+        case opcode::PUSHLOCALNAMED:
         case opcode::PUSHVIEW:
             m_code.add_line<opcode::COPYRVAL>();
             break;
@@ -0,0 +1,189 @@
+#include "layout_index.h"
+
+#include <fstream>
+#include <cmath>
+#include <set>
+
+#include "utils/utils.h"
+
+using namespace bls;
+
+static bool is_word_char(char c) {
+    // i caratteri UTF-8 non ASCII fanno parte della parola
+    return std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c) >= 0x80;
+}
+
+std::vector<std::string> bls::text_fingerprint(std::string_view text) {
+    std::set<std::string> tokens;
+    std::string last_word;
+    for (auto it = text.begin(); it != text.end();) {
+        it = std::find_if(it, text.end(), is_word_char);
+        auto end = std::find_if_not(it, text.end(), is_word_char);
+
+        std::string word(it, end);
+        for (char &c : word) {
+            c = std::tolower(static_cast<unsigned char>(c));
+        }
+        it = end;
+
+        // le parole troppo corte non sono distintive
+        if (word.size() < 3) continue;
+
+        if (!last_word.empty()) {
+            tokens.insert(last_word + ' ' + word);
+        }
+        tokens.insert(word);
+        last_word = std::move(word);
+    }
+    return {tokens.begin(), tokens.end()};
+}
+
+// ogni quanti esempi vengono tolti i token rari, altrimenti i numeri di fattura
+// dei riconoscimenti confermati farebbero crescere l'indice all'infinito
+static constexpr size_t prune_interval = 16;
+
+void layout_index::add_tokens(layout_entry &entry, std::string_view text) {
+    for (auto &token : text_fingerprint(text)) {
+        auto [it, inserted] = entry.tokens.try_emplace(std::move(token), 0);
+        if (inserted) {
+            ++m_layout_count[it->first];
+        }
+        ++it->second;
+    }
+    ++entry.samples;
+
+    if (entry.samples % prune_interval == 0) {
+        std::erase_if(entry.tokens, [&](const auto &pair) {
+            const auto &[token, count] = pair;
+            if (count * 4 >= entry.samples) return false;
+            auto it = m_layout_count.find(token);
+            if (--it->second == 0) {
+                m_layout_count.erase(it);
+            }
+            return true;
+        });
+    }
+}
+
+void layout_index::add_sample(const std::filesystem::path &layout, std::string_view text) {
+    std::scoped_lock lock(m_mutex);
+    add_tokens(m_layouts[std::filesystem::weakly_canonical(layout)], text);
+}
+
+void layout_index::confirm(const std::filesystem::path &layout, std::string_view text) {
+    std::scoped_lock lock(m_mutex);
+    auto &entry = m_layouts[std::filesystem::weakly_canonical(layout)];
+    add_tokens(entry, text);
+    ++entry.hits;
+}
+
+std::vector<std::filesystem::path> layout_index::lookup(std::string_view text, size_t max_results) const {
+    struct candidate {
+        const std::filesystem::path *layout;
+        size_t hits;
+        double score;
+    };
+
+    auto tokens = text_fingerprint(text);
+
+    std::scoped_lock lock(m_mutex);
+
+    std::vector<candidate> candidates;
+    double best_score = 0.0;
+    for (const auto &[layout, entry] : m_layouts) {
+        double score = 0.0;
+        for (const auto &token : tokens) {
+            auto it = entry.tokens.find(token);
+            if (it == entry.tokens.end()) continue;
+
+            // i token che compaiono solo in alcuni esempi del layout sono numeri o date
+            double frequency = double(it->second) / entry.samples;
+            if (frequency < 0.5) continue;
+
+            double idf = std::log(1.0 + double(m_layouts.size()) / m_layout_count.find(token)->second);
+            score += frequency * idf;
+        }
+        if (score > 0.0) {
+            candidates.push_back({&layout, entry.hits, score});
+            best_score = std::max(best_score, score);
+        }
+    }
+
+    // tra i layout con punteggio simile vengono provati prima quelli riconosciuti piu' spesso
+    std::ranges::sort(candidates, [&](const candidate &lhs, const candidate &rhs) {
+        bool lhs_close = lhs.score * 2.0 >= best_score;
+        bool rhs_close = rhs.score * 2.0 >= best_score;
+        if (lhs_close != rhs_close) return lhs_close;
+        if (lhs_close && lhs.hits != rhs.hits) return lhs.hits > rhs.hits;
+        return lhs.score > rhs.score;
+    });
+
+    if (candidates.size() > max_results) {
+        candidates.resize(max_results);
+    }
+    return candidates
+        | std::views::transform([](const candidate &c) { return *c.layout; })
+        | util::range_to_vector;
+}
+
+void layout_index::save_file(const std::filesystem::path &filename) const {
+    std::ofstream output(filename);
+    if (!output) {
+        throw file_error(intl::translate("CANT_SAVE_FILE", filename.string()));
+    }
+
+    std::scoped_lock lock(m_mutex);
+
+    output << "### Layout Index\n";
+    for (const auto &[layout, entry] : m_layouts) {
+        output << "\n### Layout " << layout.string() << '\n';
+        output << std::format("### Samples {}\n", entry.samples);
+        output << std::format("### Hits {}\n", entry.hits);
+        for (const auto &[token, count] : entry.tokens) {
+            output << std::format("{} {}\n", count, token);
+        }
+        output << "### End Layout\n";
+    }
+}
+
+static std::string_view line_suffix(std::string_view line, std::string_view prefix) {
+    return util::string_trim(line.substr(prefix.size()));
+}
+
+layout_index::layout_index(const std::filesystem::path &filename) {
+    std::ifstream input(filename);
+    if (!input) {
+        throw file_error(intl::translate("CANT_OPEN_FILE", filename.string()));
+    }
+
+    std::string line;
+    layout_entry *current = nullptr;
+    while (std::getline(input, line)) {
+        std::erase(line, '\r');
+        if (line.empty()) continue;
+
+        if (line.starts_with("### Layout Index")) {
+            continue;
+        } else if (line.starts_with("### Layout ")) {
+            current = &m_layouts[std::filesystem::path(line_suffix(line, "### Layout "))];
+        } else if (current && line.starts_with("### Samples ")) {
+            current->samples = util::string_to<size_t>(line_suffix(line, "### Samples "));
+        } else if (current && line.starts_with("### Hits ")) {
+            current->hits = util::string_to<size_t>(line_suffix(line, "### Hits "));
+        } else if (current && line == "### End Layout") {
+            current = nullptr;
+        } else if (current && line.front() != '#') {
+            size_t space = line.find(' ');
+            if (space == std::string::npos) {
+                throw parsing_error(intl::translate("INVALID_TOKEN", line));
+            }
+            std::string_view view = line;
+            auto [it, inserted] = current->tokens.emplace(view.substr(space + 1), util::string_to<size_t>(view.substr(0, space)));
+            if (inserted) {
+                ++m_layout_count[it->first];
+            }
+        } else {
+            throw parsing_error(intl::translate("INVALID_TOKEN", line));
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef __LAYOUT_INDEX_H__
+#define __LAYOUT_INDEX_H__
+
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+
+namespace bls {
+
+    // parole e coppie di parole consecutive del testo, in minuscolo e senza ripetizioni
+    std::vector<std::string> text_fingerprint(std::string_view text);
+
+    // Indice dei layout costruito dal testo della prima pagina dei pdf di esempio.
+    // Ogni layout conserva quante volte compare ogni token nei suoi esempi,
+    // i token presenti in molti layout (date, intestazioni comuni) pesano meno
+    // di quelli che identificano l'emittente (ragione sociale, partita iva).
+    class layout_index {
+    public:
+        layout_index() = default;
+
+        // carica l'indice salvato da save_file
+        explicit layout_index(const std::filesystem::path &filename);
+
+        void save_file(const std::filesystem::path &filename) const;
+
+        // aggiunge il testo della prima pagina di un pdf letto dal layout
+        void add_sample(const std::filesystem::path &layout, std::string_view text);
+
+        // registra un riconoscimento confermato da FIND_LAYOUT:
+        // il testo diventa un esempio e il layout viene provato prima degli altri simili
+        void confirm(const std::filesystem::path &layout, std::string_view text);
+
+        // ritorna al massimo max_results layout da provare, in ordine.
+        // I layout con un punteggio vicino al migliore sono ordinati per numero di riconoscimenti
+        std::vector<std::filesystem::path> lookup(std::string_view text, size_t max_results) const;
+
+        bool empty() const {
+            std::scoped_lock lock(m_mutex);
+            return m_layouts.empty();
+        }
+
+    private:
+        struct layout_entry {
+            size_t samples = 0;
+            size_t hits = 0;
+            std::map<std::string, size_t, std::less<>> tokens;
+        };
+
+        void add_tokens(layout_entry &entry, std::string_view text);
+
+    private:
+        mutable std::mutex m_mutex;
+
+        std::map<std::filesystem::path, layout_entry> m_layouts;
+
+        // numero di layout in cui compare ogni token
+        std::map<std::string, size_t, std::less<>> m_layout_count;
+    };
+
+}
+
+#endif
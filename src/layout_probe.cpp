@@ -0,0 +1,138 @@
+#include "layout_probe.h"
+
+#include <atomic>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "reader.h"
+
+using namespace bls;
+
+namespace {
+
+    constexpr size_t no_index = std::numeric_limits<size_t>::max();
+
+    class layout_probe {
+    public:
+        layout_probe(const document_source &doc, std::span<const std::filesystem::path> candidates, size_t num_threads)
+            : m_doc(doc), m_candidates(candidates), m_workers(num_threads) {}
+
+        std::optional<layout_match> operator()();
+
+    private:
+        struct worker {
+            reader probe;
+
+            // candidato in esecuzione e la sua richiesta di interruzione, protetti da m_mutex
+            size_t index = no_index;
+            std::stop_source stop;
+        };
+
+        void run_worker(worker &w);
+        void found(size_t index, const std::filesystem::path &layout);
+
+    private:
+        const document_source &m_doc;
+        std::span<const std::filesystem::path> m_candidates;
+
+        std::vector<worker> m_workers;
+
+        std::atomic<size_t> m_next = 0;
+        std::atomic<size_t> m_best = no_index;
+
+        std::mutex m_mutex;
+        std::filesystem::path m_best_layout;
+        std::map<size_t, std::exception_ptr> m_errors;
+    };
+
+    std::optional<layout_match> layout_probe::operator()() {
+        {
+            std::vector<std::jthread> threads;
+            for (auto &w : m_workers) {
+                threads.emplace_back([&]{ run_worker(w); });
+            }
+        }
+
+        if (m_best != no_index) {
+            return layout_match{m_best, std::move(m_best_layout)};
+        }
+        if (!m_errors.empty()) {
+            std::rethrow_exception(m_errors.begin()->second);
+        }
+        return std::nullopt;
+    }
+
+    void layout_probe::run_worker(worker &w) {
+        size_t index;
+        // gli indici sono assegnati in ordine, quelli dopo il migliore non servono piu'
+        while ((index = m_next++) < m_candidates.size() && index < m_best) {
+            std::stop_token stop;
+            {
+                // l'indice viene pubblicato insieme allo stop_source: found() puo' interrompere
+                // anche una prova non ancora iniziata, start() vede la richiesta dopo aver azzerato lo stato
+                std::scoped_lock lock(m_mutex);
+                if (index > m_best) break;
+                w.index = index;
+                w.stop = std::stop_source{};
+                stop = w.stop.get_token();
+            }
+            try {
+                w.probe.clear();
+                w.probe.add_flag(reader_flags::FIND_LAYOUT);
+                w.probe.set_document(m_doc);
+                w.probe.add_import(m_candidates[index]);
+                w.probe.start(stop);
+                if (w.probe.found_layout()) {
+                    found(index, w.probe.get_current_layout());
+                }
+            } catch (const reader_aborted &) {
+                // e' stato riconosciuto un candidato precedente
+            } catch (...) {
+                std::scoped_lock lock(m_mutex);
+                m_errors.emplace(index, std::current_exception());
+            }
+        }
+        std::scoped_lock lock(m_mutex);
+        w.index = no_index;
+    }
+
+    void layout_probe::found(size_t index, const std::filesystem::path &layout) {
+        std::scoped_lock lock(m_mutex);
+        if (index >= m_best) return;
+
+        m_best = index;
+        m_best_layout = layout;
+        for (auto &w : m_workers) {
+            if (w.index != no_index && w.index > index) {
+                w.stop.request_stop();
+            }
+        }
+    }
+
+}
+
+std::optional<layout_match> bls::find_layout(const document_source &doc,
+    std::span<const std::filesystem::path> candidates, size_t num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    num_threads = std::min(num_threads, candidates.size());
+    return layout_probe{doc, candidates, num_threads}();
+}
+
+std::optional<layout_match> bls::find_layout(const document_source &doc, layout_index &index,
+    size_t max_candidates, size_t num_threads)
+{
+    auto text = doc.get_page_text(pdf_rect{0.0, 0.0, 1.0, 1.0, 1});
+    auto candidates = index.lookup(text, max_candidates);
+    auto match = find_layout(doc, candidates, num_threads);
+    if (match) {
+        index.confirm(candidates[match->index], text);
+    }
+    return match;
+}
@@ -0,0 +1,37 @@
+#ifndef __LAYOUT_PROBE_H__
+#define __LAYOUT_PROBE_H__
+
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include "pdf_document.h"
+#include "layout_index.h"
+
+namespace bls {
+
+    struct layout_match {
+        size_t index;                   // posizione del layout tra i candidati
+        std::filesystem::path layout;   // layout che ha eseguito FOUNDLAYOUT
+    };
+
+    // Esegue in parallelo i layout candidati con reader_flags::FIND_LAYOUT,
+    // ogni reader si ferma al primo FOUNDLAYOUT.
+    // Vince il candidato riconosciuto con l'indice piu' basso, come se fossero provati in ordine:
+    // le prove successive vengono interrotte, quelle precedenti continuano fino alla fine.
+    // Un candidato che lancia un errore non e' riconosciuto, se nessuno lo e' viene rilanciato il primo errore.
+    // Il testo letto dal documento e' condiviso tra tutti i reader.
+    // Ogni istanza di poppler e' usata da un thread alla volta: l'estrazione del testo non ancora letto
+    // avviene in parallelo solo se il documento e' stato aperto con extract_threads > 0.
+    std::optional<layout_match> find_layout(const document_source &doc,
+        std::span<const std::filesystem::path> candidates, size_t num_threads = 0);
+
+    // Cerca nell'indice il testo della prima pagina e prova solo i primi max_candidates layout.
+    // Il layout riconosciuto viene confermato nell'indice.
+    // Ritorna nullopt se nessuno dei candidati e' riconosciuto, si puo' ripiegare sulla ricerca completa
+    std::optional<layout_match> find_layout(const document_source &doc, layout_index &index,
+        size_t max_candidates, size_t num_threads = 0);
+
+}
+
+#endif
@@ -1,12 +1,17 @@
 #include <iostream>
+#include <sstream>
 #include <filesystem>
 
 #include <cxxopts.hpp>
 
 #include "parser.h"
 #include "reader.h"
+#include "page_cache.h"
+#include "result_store.h"
+#include "document_snapshot.h"
 
 #include "utils/json_value.h"
+#include "utils/sha256.h"
 
 using namespace bls;
 
@@ -15,10 +20,23 @@ struct MainApp {
 
     std::filesystem::path input_pdf;
     std::filesystem::path input_bls;
+    std::filesystem::path cache_dir;
+    std::filesystem::path result_dir;
+    std::filesystem::path record_file;
+    std::filesystem::path replay_file;
 
     bool find_layout = false;
+    bool print_stats = false;
+    bool raw_glyphs = false;
 
     unsigned indent_size = 4;
+    unsigned extract_threads = 0;
+    size_t cache_size_mb = 256;
+
+    unsigned timeout_ms = 0;
+    size_t max_instructions = 0;
+    size_t max_call_depth = 0;
+    size_t max_memory_mb = 0;
 };
 
 static json::value variable_to_value(const variable &var) {
@@ -39,15 +57,75 @@ int MainApp::run() {
 
     reader my_reader;
 
+    pdf_document my_doc;
+    std::optional<recording_document> recorder;
+    std::optional<snapshot_document> snapshot;
+
+    std::optional<result_store> store;
+    util::sha256_digest store_key{};
+    layout_digest digest{};
+
     try {
-        pdf_document my_doc;
+        // i risultati salvati vengono restituiti senza aprire il pdf,
+        // le statistiche e le registrazioni invece si riferiscono a una lettura vera,
+        // con --replay il testo non viene dal pdf
+        if (!result_dir.empty() && !input_pdf.empty() && !print_stats && record_file.empty() && replay_file.empty()) {
+            store.emplace(result_dir);
+            digest = store->digest(input_bls);
+
+            // readfile legge file che non fanno parte della chiave
+            std::optional<util::sha256_digest> pdf_digest;
+            if (!digest.reads_files) {
+                pdf_digest = util::file_digest(input_pdf);
+            }
+            if (!pdf_digest) {
+                store.reset();
+            } else {
+                util::sha256 key;
+                key.update(std::string_view(reinterpret_cast<const char *>(pdf_digest->data()), pdf_digest->size()));
+                key.update(std::filesystem::absolute(input_bls).string());
+                key.update(find_layout);
+                key.update(indent_size);
+                key.update(raw_glyphs);
+                key.update(extract_threads);
+                if (digest.reads_doc_filename) {
+                    key.update(input_pdf.string());
+                }
+                store_key = key.digest();
+
+                if (auto stored = store->load(store_key, digest.program)) {
+                    std::cout << *stored;
+                    return 0;
+                }
+            }
+        }
+
+        warm_up();
         
-        if (!input_pdf.empty()) {
-            my_doc.open(input_pdf);
-            my_reader.set_document(my_doc);
+        if (!replay_file.empty()) {
+            snapshot.emplace(replay_file);
+            my_reader.set_document(*snapshot);
+        } else if (!input_pdf.empty()) {
+            if (!cache_dir.empty()) {
+                my_doc.set_cache(std::make_shared<page_cache>(cache_dir, uint64_t(cache_size_mb) * 1024 * 1024));
+            }
+            my_doc.set_raw_glyphs(raw_glyphs);
+            my_doc.open(input_pdf, extract_threads);
+            if (!record_file.empty()) {
+                recorder.emplace(my_doc);
+                my_reader.set_document(*recorder);
+            } else {
+                my_reader.set_document(my_doc);
+            }
         }
         
         if (find_layout) my_reader.add_flag(reader_flags::FIND_LAYOUT);
+        my_reader.set_limits({
+            .timeout = std::chrono::milliseconds(timeout_ms),
+            .max_instructions = max_instructions,
+            .max_call_depth = max_call_depth,
+            .max_memory = max_memory_mb * 1024 * 1024
+        });
         my_reader.add_layout(layout_box_list(input_bls));
         my_reader.start();
         
@@ -71,6 +149,17 @@ int MainApp::run() {
             | std::views::transform([](const std::filesystem::path &path) { return path.string(); })
             | util::range_to<json::array>;
 
+        if (print_stats) {
+            auto stats = my_reader.get_alloc_stats();
+            json::object out;
+            out["allocations"] = int(stats.allocations);
+            out["bytes"] = int(stats.bytes);
+            out["chunk_allocations"] = int(stats.chunk_allocations);
+            out["chunk_bytes"] = int(stats.chunk_bytes);
+            out["peak_bytes"] = int(stats.peak_bytes);
+            result["stats"] = std::move(out);
+        }
+
         result["errcode"] = 0;
         retcode = 0;
     } catch (const scripted_error &error) {
@@ -80,6 +169,10 @@ int MainApp::run() {
         result["layouts"] = my_reader.get_layouts()
             | std::views::transform([](const std::filesystem::path &path) { return path.string(); })
             | util::range_to<json::array>;
+    } catch (const reader_limit_error &error) {
+        // -3 tempo scaduto, -4 troppe istruzioni, -5 troppe chiamate annidate, -6 memoria esaurita
+        result["error"] = error.what();
+        result["errcode"] = -3 - int(enums::indexof(error.limit));
     } catch (const std::exception &error) {
         result["error"] = error.what();
         result["errcode"] = -1;
@@ -88,7 +181,25 @@ int MainApp::run() {
         result["errcode"] = -2;
     }
 
-    json::printer(std::cout, indent_size)(result);
+    // anche le letture fallite vengono registrate, per ripetere l'errore senza il pdf
+    if (recorder) {
+        try {
+            recorder->save_file(record_file);
+        } catch (const std::exception &error) {
+            result["error"] = error.what();
+            result["errcode"] = -1;
+            retcode = 1;
+        }
+    }
+
+    std::ostringstream output;
+    json::printer<std::ostream>(output, indent_size)(result);
+
+    // gli errori possono dipendere dai limiti e dal tempo, vengono salvate solo le letture riuscite
+    if (store && retcode == 0) {
+        store->store(store_key, digest.program, output.view());
+    }
+    std::cout << output.view();
     return retcode;
 }
 
@@ -99,11 +210,23 @@ int main(int argc, char **argv) {
         cxxopts::Options options(argv[0], intl::translate("PROGRAM_DESCRIPTION"));
 
         options.add_options()
-            ("input-bls",   intl::translate("BLS_INPUT_FILE"),      cxxopts::value(app.input_bls))
-            ("p,input-pdf", intl::translate("PDF_INPUT_FILE"),      cxxopts::value(app.input_pdf))
-            ("find-layout", intl::translate("FIND_LAYOUT"),         cxxopts::value(app.find_layout))
-            ("indent-size", intl::translate("INDENTATION_SIZE"),    cxxopts::value(app.indent_size))
-            ("h,help",      intl::translate("PRINT_HELP"))
+            ("input-bls",         intl::translate("BLS_INPUT_FILE"),       cxxopts::value(app.input_bls))
+            ("p,input-pdf",       intl::translate("PDF_INPUT_FILE"),       cxxopts::value(app.input_pdf))
+            ("find-layout",       intl::translate("FIND_LAYOUT"),          cxxopts::value(app.find_layout))
+            ("indent-size",       intl::translate("INDENTATION_SIZE"),     cxxopts::value(app.indent_size))
+            ("j,threads",         intl::translate("EXTRACT_THREADS"),      cxxopts::value(app.extract_threads))
+            ("raw-glyphs",        intl::translate("RAW_GLYPHS"),           cxxopts::value(app.raw_glyphs))
+            ("cache-dir",         intl::translate("CACHE_DIR"),            cxxopts::value(app.cache_dir))
+            ("cache-size",        intl::translate("CACHE_SIZE"),           cxxopts::value(app.cache_size_mb))
+            ("result-store",      intl::translate("RESULT_STORE"),         cxxopts::value(app.result_dir))
+            ("record",            intl::translate("RECORD_SNAPSHOT"),      cxxopts::value(app.record_file))
+            ("replay",            intl::translate("REPLAY_SNAPSHOT"),      cxxopts::value(app.replay_file))
+            ("timeout",           intl::translate("TIMEOUT"),              cxxopts::value(app.timeout_ms))
+            ("max-instructions",  intl::translate("MAX_INSTRUCTIONS"),     cxxopts::value(app.max_instructions))
+            ("max-call-depth",    intl::translate("MAX_CALL_DEPTH"),       cxxopts::value(app.max_call_depth))
+            ("max-memory",        intl::translate("MAX_MEMORY"),           cxxopts::value(app.max_memory_mb))
+            ("stats",             intl::translate("PRINT_STATS"),          cxxopts::value(app.print_stats))
+            ("h,help",            intl::translate("PRINT_HELP"))
         ;
 
         options.positional_help(intl::translate("BLS_INPUT_FILE"));
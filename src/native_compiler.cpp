@@ -0,0 +1,147 @@
+#include "native_compiler.h"
+
+#include <map>
+#include <set>
+
+#include "native_module.h"
+#include "utils/format.h"
+
+using namespace bls;
+
+namespace {
+
+    class native_writer {
+    public:
+        native_writer(std::ostream &out, const command_list &code) : out(out), m_code(code) {
+            for (auto it = code.begin(); it != code.end(); ++it) {
+                m_indices.emplace(&*it, m_indices.size());
+            }
+        }
+
+        void operator()();
+
+    private:
+        size_t index_of(command_node node) const {
+            return m_indices.at(&*node);
+        }
+
+        void write_command(size_t index, const command_args &cmd);
+
+        void write_jump(std::string_view indent, size_t index, size_t target) {
+            // i cicli controllano se la lettura e' stata interrotta
+            if (target <= index) {
+                out << indent << "if (!ctx.running()) return;\n";
+            }
+            out << indent << std::format("goto L{};\n", target);
+        }
+
+        void write_call(size_t index, std::string_view name, size_t target) {
+            // anche le chiamate, per la ricorsione
+            out << std::format("    ctx.call<opcode::{}>({});\n", name, index)
+                << "    if (!ctx.running()) return;\n"
+                << std::format("    goto L{};\n", target);
+        }
+
+    private:
+        std::ostream &out;
+        const command_list &m_code;
+
+        std::map<const command_args *, size_t> m_indices;
+
+        // comandi a cui si puo' saltare, servono le label
+        std::set<size_t> m_targets;
+
+        // comandi successivi a JSR e JSRVAL, dove ritornano le funzioni
+        std::set<size_t> m_return_sites;
+    };
+
+    void native_writer::operator()() {
+        size_t index = 0;
+        for (const auto &cmd : m_code) {
+            visit_command(util::overloaded{
+                []<opcode Cmd>(command_tag<Cmd>) {},
+                []<opcode Cmd>(command_tag<Cmd>, const auto &) {},
+                [&]<opcode Cmd>(command_tag<Cmd>, command_node node) {
+                    m_targets.insert(index_of(node));
+                    if constexpr (Cmd == opcode::JSR || Cmd == opcode::JSRVAL) {
+                        m_return_sites.insert(index + 1);
+                    }
+                }
+            }, cmd);
+            ++index;
+        }
+        m_targets.insert(m_return_sites.begin(), m_return_sites.end());
+
+        out << "// generato da blsaot, non modificare\n"
+            << "#include \"native_module.h\"\n\n"
+            << "using namespace bls;\n\n"
+            << "static void run(native_context &ctx) {\n";
+
+        index = 0;
+        for (const auto &cmd : m_code) {
+            if (m_targets.contains(index)) {
+                out << std::format("L{}:\n", index);
+            }
+            if (cmd.command() != opcode::NOP && cmd.command() != opcode::LABEL) {
+                write_command(index, cmd);
+            }
+            ++index;
+        }
+
+        out << "dispatch:\n"
+            << "    switch (ctx.return_index()) {\n";
+        for (size_t site : m_return_sites) {
+            out << std::format("    case {0}: goto L{0};\n", site);
+        }
+        out << "    default: return;\n"
+            << "    }\n"
+            << "}\n\n"
+            << std::format("BLS_NATIVE_EXPORT const native_module_info BLS_NATIVE_SYMBOL{{\"{}\", run}};\n", util::to_hex(bytecode_hash(m_code)));
+    }
+
+    void native_writer::write_command(size_t index, const command_args &cmd) {
+        auto name = enums::to_string(cmd.command());
+        visit_command(util::overloaded{
+            [&]<opcode Cmd>(command_tag<Cmd>) {
+                out << std::format("    ctx.exec<opcode::{}>({});\n", name, index);
+            },
+            [&]<opcode Cmd>(command_tag<Cmd>, const auto &) {
+                out << std::format("    ctx.exec<opcode::{}>({});\n", name, index);
+            },
+            [&]<opcode Cmd>(command_tag<Cmd>, command_node node) {
+                out << std::format("    if (ctx.branch<opcode::{}>({})) {{\n", name, index);
+                write_jump("        ", index, index_of(node));
+                out << "    }\n";
+            },
+            [&](command_tag<opcode::JMP>, command_node node) {
+                write_jump("    ", index, index_of(node));
+            },
+            [&](command_tag<opcode::JSR>, command_node node) {
+                write_call(index, name, index_of(node));
+            },
+            [&](command_tag<opcode::JSRVAL>, command_node node) {
+                write_call(index, name, index_of(node));
+            },
+            [&](command_tag<opcode::MEMOLOOKUP>, size_t) {
+                out << std::format("    if (ctx.memo_lookup({})) goto dispatch;\n", index);
+            },
+            [&](command_tag<opcode::RET>) {
+                out << std::format("    if (!ctx.ret({})) return;\n", index)
+                    << "    goto dispatch;\n";
+            },
+            [&](command_tag<opcode::IMPORT>, const std::string &) {
+                out << std::format("    ctx.import({});\n", index)
+                    << "    if (!ctx.running()) return;\n";
+            },
+            [&](command_tag<opcode::FOUNDLAYOUT>) {
+                out << std::format("    ctx.exec<opcode::FOUNDLAYOUT>({});\n", index)
+                    << "    if (!ctx.running()) return;\n";
+            },
+        }, cmd);
+    }
+
+}
+
+void bls::write_native_source(std::ostream &out, const command_list &code) {
+    native_writer{out, code}();
+}
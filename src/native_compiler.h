@@ -0,0 +1,17 @@
+#ifndef __NATIVE_COMPILER_H__
+#define __NATIVE_COMPILER_H__
+
+#include <iostream>
+
+#include "bytecode.h"
+
+namespace bls {
+
+    // Traduce il codice compilato in un sorgente C++ da compilare come modulo nativo.
+    // Ogni comando chiama la stessa funzione dell'interprete, i salti e le chiamate
+    // diventano goto, il ritorno dalle funzioni passa da uno switch sugli indirizzi di ritorno
+    void write_native_source(std::ostream &out, const command_list &code);
+
+}
+
+#endif
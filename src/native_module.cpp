@@ -0,0 +1,60 @@
+#include "native_module.h"
+
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "bytecode_printer.h"
+
+using namespace bls;
+
+util::sha256_digest bls::bytecode_hash(const command_list &code) {
+    // deve restare uguale tra blsaot e il reader
+    util::sha256 hash;
+    for (auto it = code.begin(); it != code.end(); ++it) {
+        std::ostringstream line;
+        line << bytecode_printer(code, it) << '\n';
+        hash.update(line.view());
+    }
+    return hash.digest();
+}
+
+#define STRINGIZE(x) #x
+#define SYMBOL_NAME(x) STRINGIZE(x)
+
+static void close_library(void *handle) {
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(handle));
+#else
+    dlclose(handle);
+#endif
+}
+
+native_module::native_module(const std::filesystem::path &filename) {
+#ifdef _WIN32
+    m_handle = LoadLibraryW(filename.c_str());
+    if (m_handle) {
+        m_info = reinterpret_cast<const native_module_info *>(GetProcAddress(static_cast<HMODULE>(m_handle), SYMBOL_NAME(BLS_NATIVE_SYMBOL)));
+    }
+#else
+    m_handle = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (m_handle) {
+        m_info = static_cast<const native_module_info *>(dlsym(m_handle, SYMBOL_NAME(BLS_NATIVE_SYMBOL)));
+    }
+#endif
+    if (!m_handle) {
+        throw file_error(intl::translate("CANT_OPEN_FILE", filename.string()));
+    }
+    if (!m_info) {
+        close_library(m_handle);
+        throw file_error(intl::translate("INVALID_NATIVE_MODULE", filename.string()));
+    }
+}
+
+native_module::~native_module() {
+    close_library(m_handle);
+}
@@ -0,0 +1,117 @@
+#ifndef __NATIVE_MODULE_H__
+#define __NATIVE_MODULE_H__
+
+#include <filesystem>
+#include <memory>
+
+#include "reader.h"
+#include "utils/sha256.h"
+
+#ifdef _WIN32
+#define BLS_NATIVE_EXPORT extern "C" __declspec(dllexport)
+#else
+#define BLS_NATIVE_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// nome del simbolo native_module_info esportato dai moduli generati da blsaot
+#define BLS_NATIVE_SYMBOL bls_native_module
+
+namespace bls {
+
+    // SHA-256 del bytecode stampato, il modulo nativo viene usato solo se corrisponde al codice caricato
+    util::sha256_digest bytecode_hash(const command_list &code);
+
+    // Interfaccia tra il codice generato da blsaot e il reader.
+    // I comandi sono indicati con la loro posizione nel codice, i salti
+    // vengono tradotti in goto e l'esecuzione torna all'interprete solo per i file importati
+    class native_context {
+    public:
+        native_context(reader &r) : m_reader(r), m_ops(reader::native_ops()) {}
+
+        bool running() const {
+            return m_reader.m_running;
+        }
+
+        template<opcode Cmd> void exec(size_t index) {
+            m_ops[enums::indexof(Cmd)](m_reader, *m_reader.m_native_nodes[index]);
+            m_reader.count_instruction();
+        }
+
+        // ritorna true se il salto viene eseguito
+        template<opcode Cmd> bool branch(size_t index) {
+            auto next = set_counter(index);
+            exec<Cmd>(index);
+            return m_reader.m_program_counter_next != next;
+        }
+
+        // salva l'indirizzo di ritorno, il codice generato salta all'inizio della funzione
+        template<opcode Cmd> void call(size_t index) {
+            set_counter(index);
+            exec<Cmd>(index);
+        }
+
+        // ritorna true se il risultato era in cache e la funzione e' ritornata
+        bool memo_lookup(size_t index) {
+            return branch<opcode::MEMOLOOKUP>(index);
+        }
+
+        // ritorna false se e' finita la lettura
+        bool ret(size_t index) {
+            exec<opcode::RET>(index);
+            return running();
+        }
+
+        // posizione del comando a cui e' ritornata l'ultima funzione
+        size_t return_index() const {
+            return m_reader.m_native_indices.at(&*m_reader.m_program_counter_next);
+        }
+
+        // il codice importato viene interpretato fino al ritorno
+        void import(size_t index) {
+            auto next = set_counter(index);
+            exec<opcode::IMPORT>(index);
+            m_reader.run_until(next);
+        }
+
+    private:
+        command_node set_counter(size_t index) {
+            auto node = m_reader.m_native_nodes[index];
+            m_reader.m_program_counter = node;
+            return m_reader.m_program_counter_next = std::next(node);
+        }
+
+    private:
+        reader &m_reader;
+        const reader::op_table &m_ops;
+    };
+
+    struct native_module_info {
+        const char *code_hash;      // bytecode_hash in esadecimale
+        void (*run)(native_context &ctx);
+    };
+
+    // libreria generata da blsaot, resta caricata finche' e' usata da un reader
+    class native_module {
+    public:
+        native_module(const std::filesystem::path &filename);
+        ~native_module();
+
+        native_module(const native_module &) = delete;
+        native_module &operator = (const native_module &) = delete;
+
+        std::string_view code_hash() const {
+            return m_info->code_hash;
+        }
+
+        void run(native_context &ctx) const {
+            m_info->run(ctx);
+        }
+
+    private:
+        void *m_handle = nullptr;
+        const native_module_info *m_info = nullptr;
+    };
+
+}
+
+#endif
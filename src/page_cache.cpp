@@ -0,0 +1,196 @@
+#include "page_cache.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include <poppler-config.h>
+
+#include "utils/atomic_file.h"
+
+using namespace bls;
+
+namespace fs = std::filesystem;
+
+enum entry_kind : uint32_t {
+    ENTRY_TEXT,
+    ENTRY_GLYPHS
+};
+
+static constexpr const char *entry_extension = ".bpc";
+
+// i campi sono allineati senza padding, l'intestazione viene scritta cosi' com'e'
+struct entry_header {
+    char magic[4];
+    uint32_t kind;
+    char poppler[16];
+    uint8_t document[32];
+    double x, y, w, h;
+    int32_t page;
+    int32_t mode;
+    uint64_t size;
+};
+
+static_assert(sizeof(entry_header) == 104);
+static_assert(std::is_trivially_copyable_v<glyph>);
+
+// tutti i campi tranne size identificano la voce
+static constexpr size_t key_size = offsetof(entry_header, size);
+
+static entry_header make_header(const util::sha256_digest &document, const pdf_rect &rect, uint32_t kind) {
+    entry_header header{};
+    std::memcpy(header.magic, "BPC2", sizeof(header.magic));
+    header.kind = kind;
+    std::strncpy(header.poppler, POPPLER_VERSION, sizeof(header.poppler) - 1);
+    std::memcpy(header.document, document.data(), sizeof(header.document));
+    header.x = rect.x;
+    header.y = rect.y;
+    header.w = rect.w;
+    header.h = rect.h;
+    header.page = rect.page;
+    header.mode = static_cast<int32_t>(enums::indexof(rect.mode));
+    return header;
+}
+
+static fs::path entry_path(const fs::path &directory, const entry_header &header) {
+    auto hash = util::sha256{}.update(std::string_view(reinterpret_cast<const char *>(&header), key_size)).digest();
+    return directory / (util::to_hex(hash) + entry_extension);
+}
+
+// i nomi delle voci sono l'hash esadecimale della chiave, seguito da entry_extension
+static bool is_entry_path(const fs::path &path) {
+    if (path.extension() != entry_extension) return false;
+    auto stem = path.stem().string();
+    return stem.size() == 64 && std::ranges::all_of(stem, [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+// in modalita' RAW viene salvata la pagina intera
+static pdf_rect glyph_page_rect(int page) {
+    return pdf_rect{0.0, 0.0, 1.0, 1.0, page, read_mode::RAW};
+}
+
+page_cache::page_cache(const fs::path &directory, uint64_t max_bytes)
+    : m_directory(directory), m_max_bytes(max_bytes)
+{
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec || !fs::is_directory(m_directory)) {
+        throw file_error(intl::translate("CANT_OPEN_FILE", m_directory.string()));
+    }
+}
+
+std::optional<std::string> page_cache::load(const util::sha256_digest &document, const pdf_rect &rect, uint32_t kind) const {
+    auto expected = make_header(document, rect, kind);
+    auto path = entry_path(m_directory, expected);
+
+    std::ifstream input(path, std::ios::binary);
+    if (!input) return std::nullopt;
+
+    // una voce con la chiave diversa non appartiene a questo rettangolo, una troncata e' danneggiata
+    std::error_code ec;
+    auto file_size = fs::file_size(path, ec);
+    entry_header header;
+    if (ec || !input.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(&header, &expected, key_size) != 0
+        || header.size != file_size - sizeof(header)) {
+        return std::nullopt;
+    }
+
+    std::string data(header.size, '\0');
+    if (!input.read(data.data(), data.size())) {
+        return std::nullopt;
+    }
+    input.close();
+
+    // la data di modifica tiene l'ordine delle letture per la pulizia
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return data;
+}
+
+void page_cache::store(const util::sha256_digest &document, const pdf_rect &rect, uint32_t kind, std::string_view data) {
+    auto header = make_header(document, rect, kind);
+    header.size = data.size();
+    auto path = entry_path(m_directory, header);
+
+    // le voci con la stessa chiave hanno lo stesso contenuto
+    std::error_code ec;
+    if (fs::exists(path, ec)) return;
+
+    std::string_view parts[] = {
+        std::string_view(reinterpret_cast<const char *>(&header), sizeof(header)),
+        data
+    };
+    if (!util::write_file_atomic(path, parts)) return;
+
+    if (m_max_bytes) {
+        std::scoped_lock lock(m_mutex);
+        if (!m_total_bytes || (*m_total_bytes += sizeof(header) + data.size()) > m_max_bytes) {
+            evict();
+        }
+    }
+}
+
+void page_cache::evict() {
+    struct entry {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+
+    std::vector<entry> entries;
+    uint64_t total = 0;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(m_directory, ec), end; !ec && it != end; it.increment(ec)) {
+        // la cartella puo' contenere altri file, e le voci ancora in scrittura hanno un nome temporaneo
+        if (!is_entry_path(it->path())) continue;
+        std::error_code entry_ec;
+        if (!it->is_regular_file(entry_ec)) continue;
+        entry e{it->path(), it->last_write_time(entry_ec), it->file_size(entry_ec)};
+        // il file puo' essere stato cancellato da un altro processo
+        if (entry_ec) continue;
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+
+    if (total > m_max_bytes) {
+        // viene liberato un quarto della cache, per non ripulire ad ogni scrittura
+        std::ranges::sort(entries, {}, &entry::time);
+        for (const auto &e : entries) {
+            if (total <= m_max_bytes / 4 * 3) break;
+            // se non c'e' piu' l'ha cancellato un altro processo
+            fs::remove(e.path, ec);
+            if (!ec) {
+                total -= e.size;
+            }
+        }
+    }
+
+    m_total_bytes = total;
+}
+
+std::optional<std::string> page_cache::load_text(const util::sha256_digest &document, const pdf_rect &rect) const {
+    return load(document, rect, ENTRY_TEXT);
+}
+
+void page_cache::store_text(const util::sha256_digest &document, const pdf_rect &rect, std::string_view text) {
+    store(document, rect, ENTRY_TEXT, text);
+}
+
+std::optional<std::vector<glyph>> page_cache::load_glyphs(const util::sha256_digest &document, int page) const {
+    auto data = load(document, glyph_page_rect(page), ENTRY_GLYPHS);
+    if (!data || data->size() % sizeof(glyph) != 0) {
+        return std::nullopt;
+    }
+    std::vector<glyph> glyphs(data->size() / sizeof(glyph));
+    std::memcpy(glyphs.data(), data->data(), data->size());
+    return glyphs;
+}
+
+void page_cache::store_glyphs(const util::sha256_digest &document, int page, std::span<const glyph> glyphs) {
+    store(document, glyph_page_rect(page), ENTRY_GLYPHS,
+        std::string_view(reinterpret_cast<const char *>(glyphs.data()), glyphs.size_bytes()));
+}
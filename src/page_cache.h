@@ -0,0 +1,50 @@
+#ifndef __PAGE_CACHE_H__
+#define __PAGE_CACHE_H__
+
+#include <filesystem>
+#include <optional>
+#include <mutex>
+#include <span>
+
+#include "pdf_document.h"
+#include "utils/sha256.h"
+
+namespace bls {
+
+    // Cache su disco del testo estratto da poppler, condivisa tra i processi.
+    // Le voci sono indicizzate dallo SHA-256 del contenuto del pdf, dalla pagina, dalla modalita'
+    // e dalla versione di poppler: un pdf rinominato o copiato viene ritrovato.
+    // Ogni voce e' un file con un'intestazione fissa, che contiene la chiave completa,
+    // seguita dal testo del rettangolo o dall'array dei caratteri della pagina.
+    // Oltre max_bytes vengono cancellate le voci lette meno di recente
+    class page_cache {
+    public:
+        // max_bytes = 0 vuol dire nessun limite
+        explicit page_cache(const std::filesystem::path &directory, uint64_t max_bytes = 0);
+
+        std::optional<std::string> load_text(const util::sha256_digest &document, const pdf_rect &rect) const;
+        void store_text(const util::sha256_digest &document, const pdf_rect &rect, std::string_view text);
+
+        std::optional<std::vector<glyph>> load_glyphs(const util::sha256_digest &document, int page) const;
+        void store_glyphs(const util::sha256_digest &document, int page, std::span<const glyph> glyphs);
+
+    private:
+        std::optional<std::string> load(const util::sha256_digest &document, const pdf_rect &rect, uint32_t kind) const;
+        void store(const util::sha256_digest &document, const pdf_rect &rect, uint32_t kind, std::string_view data);
+
+        void evict();
+
+    private:
+        std::filesystem::path m_directory;
+        uint64_t m_max_bytes;
+
+        // stima della dimensione della cartella, aggiornata ad ogni scrittura e ricalcolata
+        // ad ogni pulizia perche' anche gli altri processi ci scrivono.
+        // Viene calcolata alla prima scrittura, i processi che trovano tutto in cache non leggono la cartella
+        std::optional<uint64_t> m_total_bytes;
+        std::mutex m_mutex;
+    };
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "bytecode.h"
 #include "fixed_point.h"
 #include "functions.h"
+#include "type_inference.h"
 #include "utils/filter_enum_sequence.h"
 
 using namespace bls;
@@ -19,6 +20,33 @@ constexpr auto is_label = [](const command_args &cmd) {
     return cmd.command() == opcode::LABEL;
 };
 
+template<opcode Cmd> static command_args make_jump(command_node node) {
+    return make_command<Cmd>(node);
+}
+
+using fused_jump = std::pair<std::string_view, command_args (*)(command_node)>;
+
+static constexpr fused_jump fused_jumps[] {
+    {"not", make_jump<opcode::JNZ>},
+    {"eq",  make_jump<opcode::JZEQ>},
+    {"neq", make_jump<opcode::JZNEQ>},
+    {"lt",  make_jump<opcode::JZLT>},
+    {"gt",  make_jump<opcode::JZGT>},
+    {"leq", make_jump<opcode::JZLEQ>},
+    {"geq", make_jump<opcode::JZGEQ>},
+};
+
+void parser_code::add_jz(command_node label) {
+    if (auto &last = last_not_comment(); last.command() == opcode::CALL) {
+        std::string_view fun_name = last.get_args<opcode::CALL>()->first;
+        if (auto it = std::ranges::find(fused_jumps, fun_name, &fused_jump::first); it != std::end(fused_jumps)) {
+            last = it->second(label);
+            return;
+        }
+    }
+    add_line<opcode::JZ>(label);
+}
+
 command_list parser::operator()(const layout_box_list &layout) {
     m_path = std::filesystem::weakly_canonical(layout.filename);
     m_code.add_line<opcode::SETPATH>(m_path.string());
@@ -56,6 +84,10 @@ command_list parser::operator()(const layout_box_list &layout) {
     
     m_code.add_line<opcode::RET>();
 
+    if (m_flags.check(parser_flags::TYPED_OPCODES)) {
+        specialize_typed_ops(m_code);
+    }
+
     if (m_flags.check(parser_flags::OPTIMIZE_LABELS)) {
         for (command_args &line : m_code) {
             visit_command(util::overloaded{
@@ -122,19 +154,11 @@ void parser::read_box(const layout_box &box) {
     }
 
     if (!box.flags.check(box_flags::NOREAD) || box.flags.check(box_flags::SPACER)) {
-        m_code.add_line<opcode::NEWBOX>();
-        if (!box.flags.check(box_flags::PAGE)) {
-            m_code.add_line<opcode::PUSHDOUBLE>(box.x);
-            m_code.add_line<opcode::MVBOX>(spacer_index::X);
-            m_code.add_line<opcode::PUSHDOUBLE>(box.y);
-            m_code.add_line<opcode::MVBOX>(spacer_index::Y);
-            m_code.add_line<opcode::PUSHDOUBLE>(box.w);
-            m_code.add_line<opcode::MVBOX>(spacer_index::WIDTH);
-            m_code.add_line<opcode::PUSHDOUBLE>(box.h);
-            m_code.add_line<opcode::MVBOX>(spacer_index::HEIGHT);
+        if (box.flags.check(box_flags::PAGE)) {
+            m_code.add_line<opcode::SETBOX>(pdf_rect{0.0, 0.0, 0.0, 0.0, box.page});
+        } else {
+            m_code.add_line<opcode::SETBOX>(pdf_rect{box.x, box.y, box.w, box.h, box.page});
         }
-        m_code.add_line<opcode::PUSHINT>(box.page);
-        m_code.add_line<opcode::MVBOX>(spacer_index::PAGE);
     }
 
     if (!m_flags.check(parser_flags::SKIP_COMMENTS)) {
@@ -300,11 +324,7 @@ void parser::parse_foreach_expression() {
         m_lexer.require(token_type::PAREN_BEGIN);
         read_expression();
         m_lexer.require(token_type::PAREN_END);
-        if (auto &last = m_code.last_not_comment(); last.command() == opcode::CALL && last.get_args<opcode::CALL>()->first == "not") {
-            last = make_command<opcode::JNZ>(label_loop_next);
-        } else {
-            m_code.add_line<opcode::JZ>(label_loop_next);
-        }
+        m_code.add_jz(label_loop_next);
     }
 
     read_expression();
@@ -324,11 +344,7 @@ void parser::parse_ternary_expression() {
     auto endif_label = m_code.make_label();
     auto else_label = m_code.make_label();
 
-    if (auto &last = m_code.last_not_comment(); last.command() == opcode::CALL && last.get_args<opcode::CALL>()->first == "not") {
-        last = make_command<opcode::JNZ>(else_label);
-    } else {
-        m_code.add_line<opcode::JZ>(else_label);
-    }
+    m_code.add_jz(else_label);
     read_expression();
     m_lexer.require(token_type::COLON);
 
@@ -475,13 +491,21 @@ void parser::sub_expression() {
         if (m_lexer.peek().type == token_type::PAREN_BEGIN) {
             read_function(tok_first, false);
         } else {
-            m_code.add_line<opcode::SELVAR>(tok_first.value);
-            m_code.add_line<opcode::PUSHVAR>();
+            m_code.add_line<opcode::PUSHVARNAMED>(tok_first.value);
         }
         break;
     default:
         read_variable_name();
-        m_code.add_line<opcode::PUSHVAR>();
+        switch (auto &last = m_code.last_not_comment(); last.command()) {
+        case opcode::SELGLOBAL:
+            last = make_command<opcode::PUSHGLOBALNAMED>(last.get_args<opcode::SELGLOBAL>());
+            break;
+        case opcode::SELLOCAL:
+            last = make_command<opcode::PUSHLOCALNAMED>(last.get_args<opcode::SELLOCAL>());
+            break;
+        default:
+            m_code.add_line<opcode::PUSHVAR>();
+        }
     }
     
     while (m_lexer.check_next(token_type::BRACKET_BEGIN)) {
@@ -567,15 +591,12 @@ void parser::read_function(token tok_fun_name, bool top_level) {
         if (num_args < fun.minargs || num_args > fun.maxargs) {
             throw invalid_numargs(std::string(fun_name), fun.minargs, fun.maxargs, tok_fun_name);
         }
-        if (fun.minargs != fun.maxargs) {
-            m_code.add_line<opcode::CALLARGS>(num_args);
-        }
         if (fun.returns_value) {
             if (top_level) throw token_error(intl::translate("CANT_CALL_FROM_TOP_LEVEL", fun_name), tok_fun_name);
-            m_code.add_line<opcode::CALL>(it);
+            m_code.add_line<opcode::CALL>(it, num_args);
         } else {
             if (!top_level) throw token_error(intl::translate("CANT_CALL_OUT_OF_TOP_LEVEL", fun_name), tok_fun_name);
-            m_code.add_line<opcode::SYSCALL>(it);
+            m_code.add_line<opcode::SYSCALL>(it, num_args);
         }
     } else if (auto it = m_functions.find(fun_name); it != m_functions.end()) {
         const auto &fun = it->second;
@@ -584,10 +605,37 @@ void parser::read_function(token tok_fun_name, bool top_level) {
         }
         if (top_level) {
             m_code.add_line<opcode::JSR>(fun.node);
+        } else if (!fun.inline_code.empty()) {
+            add_inline_function(fun);
         } else {
             m_code.add_line<opcode::JSRVAL>(fun.node);
         }
     } else {
         throw token_error(intl::translate("UNKNOWN_FUNCTION", fun_name), tok_fun_name);
     }
+}
+
+void parser::add_inline_function(const function_info &fun) {
+    // gli argomenti restano sullo stack, le label vengono ricreate
+    std::map<int, command_node> labels;
+    for (const command_args &line : fun.inline_code) {
+        if (line.command() == opcode::LABEL) {
+            labels.emplace(line.get_args<opcode::LABEL>().id, m_code.make_label());
+        }
+    }
+    for (command_args line : fun.inline_code) {
+        if (line.command() == opcode::LABEL) {
+            m_code.add_label(labels.at(line.get_args<opcode::LABEL>().id));
+        } else {
+            visit_command(util::overloaded{
+                []<opcode Cmd>(command_tag<Cmd>) {},
+                []<opcode Cmd>(command_tag<Cmd>, auto &) {},
+                [&]<opcode Cmd>(command_tag<Cmd>, command_node &node) {
+                    node = labels.at(node->get_args<opcode::LABEL>().id);
+                }
+            }, line);
+            m_code.push_back(std::move(line));
+        }
+    }
+    m_code.add_line<opcode::STKDROP>(fun.numargs);
 }
\ No newline at end of file
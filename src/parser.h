@@ -34,6 +34,12 @@ namespace bls {
     struct function_info {
         command_node node;
         size_t numargs;
+
+        // corpo da espandere nel punto di chiamata, vuoto se la funzione non si puo' espandere
+        std::vector<command_args> inline_code;
+
+        // vero se il risultato dipende solo dagli argomenti
+        bool pure = false;
     };
 
     struct parser_code : command_list {
@@ -67,11 +73,15 @@ namespace bls {
         void add_line(Ts && ... args) {
             push_back(new_line<Cmd>(std::forward<Ts>(args) ... ));
         }
+
+        // aggiunge un JZ, unendolo all'ultimo CALL se e' un confronto o un not
+        void add_jz(command_node label);
     };
 
     DEFINE_ENUM_FLAGS(parser_flags,
         (SKIP_COMMENTS)
         (OPTIMIZE_LABELS)
+        (TYPED_OPCODES)
     )
 
     class parser {
@@ -96,6 +106,7 @@ namespace bls {
         void parse_ternary_expression();
 
         void read_function(token tok_fun_name, bool top_level);
+        void add_inline_function(const function_info &fun);
         void read_variable_name();
         void read_variable_indices();
 
@@ -104,6 +115,7 @@ namespace bls {
         void parse_for_stmt();
         void parse_goto_stmt();
         void parse_function_stmt();
+        bool is_pure_function(command_node begin, command_node end) const;
         void parse_foreach_stmt();
         void parse_with_stmt();
         void parse_import_stmt();
@@ -1,4 +1,5 @@
 #include "pdf_document.h"
+#include "page_cache.h"
 
 #include <iostream>
 #include <fstream>
@@ -9,16 +10,19 @@
 #include <SplashOutputDev.h>
 #include <splash/SplashBitmap.h>
 
+
 using namespace bls;
 
-static const GlobalParamsIniter errorFunction([](ErrorCategory, Goffset pos, const char *msg) {
-    if (pos >= 0) {
-        std::cerr << "poppler error (" << pos << "): ";
-    } else {
-        std::cerr << "poppler error: ";
-    }
-    std::cerr << msg << std::endl;
-});
+void pdf_document::init_poppler() {
+    static const GlobalParamsIniter errorFunction([](ErrorCategory, Goffset pos, const char *msg) {
+        if (pos >= 0) {
+            std::cerr << "poppler error (" << pos << "): ";
+        } else {
+            std::cerr << "poppler error: ";
+        }
+        std::cerr << msg << std::endl;
+    });
+}
 
 void pdf_rect::rotate(int amt) {
     switch (amt % 4) {
@@ -58,21 +62,240 @@ pdf_image &pdf_image::operator = (pdf_image &&other) noexcept {
     return *this;
 }
 
-void pdf_document::open(const std::filesystem::path &filename) {
+static std::unique_ptr<PDFDoc> open_pdf(const std::filesystem::path &filename) {
     if constexpr (std::is_constructible_v<PDFDoc, std::unique_ptr<GooString> &&>) {
-        m_document = std::make_unique<PDFDoc>(std::make_unique<GooString>(filename.string()));
+        return std::make_unique<PDFDoc>(std::make_unique<GooString>(filename.string()));
     } else {
-        m_document = std::make_unique<PDFDoc>(new GooString(filename.string()));
+        return std::make_unique<PDFDoc>(new GooString(filename.string()));
+    }
+}
+
+// chiamata da poppler durante il disegno, se ritorna true si ferma
+static bool abort_check(void *data) {
+    return static_cast<const cancel_token *>(data)->cancelled();
+}
+
+void pdf_document::close() {
+    // l'estrazione va fermata prima di toccare le istanze di poppler
+    {
+        std::scoped_lock lock(m_prefetch_mutex);
+        m_prefetch_thread = {};
+        m_prefetch_stop.request_stop();
+        m_prefetch_stop = {};
+        m_prefetch_rects.clear();
+        m_prefetch_next = 0;
+    }
+    m_extract_threads.clear();
+
+    {
+        std::scoped_lock lock(m_documents_mutex);
+        m_free_documents.clear();
+        m_extra_documents.clear();
+    }
+    {
+        std::scoped_lock lock(m_text_mutex);
+        m_text_cache.clear();
+        m_glyph_pages.clear();
     }
+
+    m_num_pages = 0;
+    m_document.reset();
+}
+
+void pdf_document::open(const std::filesystem::path &filename, size_t extract_threads) {
+    init_poppler();
+    close();
+
+    m_document = open_pdf(filename);
     if (!m_document->isOk()) {
         m_document.reset();
         throw file_error(intl::translate("CANT_OPEN_FILE", filename.string()));
     }
+    m_num_pages = m_document->getNumPages();
+    m_free_documents.push_back(m_document.get());
+
+    // la cache riconosce il documento dal contenuto, non dal nome
+    if (m_cache) {
+        auto digest = util::file_digest(filename);
+        if (!digest) {
+            m_document.reset();
+            throw file_error(intl::translate("CANT_OPEN_FILE", filename.string()));
+        }
+        m_content_digest = *digest;
+    }
+
+    for (size_t i = 0; i < extract_threads; ++i) {
+        m_extract_threads.emplace_back([this, filename](std::stop_token stop) {
+            extract_thread(stop, filename);
+        });
+    }
+}
+
+void pdf_document::set_cache(std::shared_ptr<page_cache> cache) {
+    if (!isopen()) {
+        m_cache = std::move(cache);
+        return;
+    }
+
+    // i thread in background leggono la cache, il documento viene riaperto
+    // con lo stesso numero di thread per calcolare l'hash del contenuto
+    auto filename = this->filename();
+    size_t extract_threads = m_extract_threads.size();
+    close();
+    m_cache = std::move(cache);
+    open(filename, extract_threads);
+}
+
+void pdf_document::extract_thread(std::stop_token stop, std::filesystem::path filename) {
+    // ogni thread apre un'altra istanza di PDFDoc, che serve anche le letture degli altri thread
+    auto document = open_pdf(filename);
+    if (!document->isOk()) return;
+    {
+        std::scoped_lock lock(m_documents_mutex);
+        m_free_documents.push_back(m_extra_documents.emplace_back(std::move(document)).get());
+    }
+    m_document_released.notify_one();
+
+    // ogni thread usa al massimo un'istanza alla volta, ne resta sempre una libera per i reader
+    while (true) {
+        pdf_rect rect;
+        std::stop_token plan_stop;
+        {
+            std::unique_lock lock(m_prefetch_mutex);
+            if (!m_prefetch_ready.wait(lock, stop, [&] { return m_prefetch_next < m_prefetch_rects.size(); })) {
+                return;
+            }
+            rect = m_prefetch_rects[m_prefetch_next++];
+            plan_stop = m_prefetch_stop.get_token();
+        }
+        try {
+            cached_text(rect, cancel_token{plan_stop});
+        } catch (const pdf_cancelled &) {}
+    }
+}
+
+void pdf_document::document_release::operator()(PDFDoc *document) const {
+    {
+        std::scoped_lock lock(owner->m_documents_mutex);
+        owner->m_free_documents.push_back(document);
+    }
+    owner->m_document_released.notify_one();
 }
 
-std::string pdf_document::get_text(const pdf_rect &rect) const {
+pdf_document::document_lease pdf_document::lease_document(const cancel_token &token) const {
+    // un altro thread puo' essere bloccato a lungo dentro poppler
+    std::unique_lock lock(m_documents_mutex);
+    while (m_free_documents.empty()) {
+        m_document_released.wait_for(lock, std::chrono::milliseconds(10));
+        token.check();
+    }
+    PDFDoc *document = m_free_documents.back();
+    m_free_documents.pop_back();
+    return document_lease(document, document_release{this});
+}
+
+std::string pdf_document::get_text(const pdf_rect &rect, const cancel_token &token) const {
+    if (!isopen() || rect.page > num_pages() || rect.page < 1) return {};
+    return cached_text(rect, token);
+}
+
+std::string pdf_document::cached_text(const pdf_rect &rect, const cancel_token &token) const {
+    while (true) {
+        std::promise<std::string> promise;
+        std::shared_future<std::string> future;
+        bool reading = false;
+        {
+            std::scoped_lock lock(m_text_mutex);
+            auto [it, inserted] = m_text_cache.try_emplace(rect);
+            if (inserted) {
+                it->second = promise.get_future().share();
+                reading = true;
+            }
+            future = it->second;
+        }
+
+        if (reading) {
+            try {
+                promise.set_value(load_text(rect, token));
+            } catch (...) {
+                // una lettura interrotta non resta in cache, viene ripetuta alla prossima richiesta
+                {
+                    std::scoped_lock lock(m_text_mutex);
+                    m_text_cache.erase(rect);
+                }
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+        while (future.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+            token.check();
+        }
+        try {
+            return future.get();
+        } catch (const pdf_cancelled &) {
+            // e' stata interrotta la lettura di un altro thread, questa la ripete
+            token.check();
+        }
+    }
+}
+
+std::string pdf_document::load_text(const pdf_rect &rect, const cancel_token &token) const {
+    // con m_raw_glyphs la cache su disco contiene i caratteri della pagina, salvati da page_glyphs
+    const bool use_cache = m_cache && !(m_raw_glyphs && rect.mode == read_mode::RAW);
+    if (use_cache) {
+        if (auto text = m_cache->load_text(m_content_digest, rect)) {
+            return std::move(*text);
+        }
+    }
+    auto document = lease_document(token);
+    auto text = read_text(*document, rect, token);
+    if (use_cache) {
+        m_cache->store_text(m_content_digest, rect, text);
+    }
+    return text;
+}
+
+pdf_document::glyph_page pdf_document::page_glyphs(PDFDoc &document, int page, const cancel_token &token) const {
+    {
+        std::scoped_lock lock(m_text_mutex);
+        if (auto it = m_glyph_pages.find(page); it != m_glyph_pages.end()) {
+            return it->second;
+        }
+    }
+
+    // due thread possono estrarre la stessa pagina, viene tenuta la prima
+    glyph_page glyphs;
+    if (m_cache) {
+        if (auto cached = m_cache->load_glyphs(m_content_digest, page)) {
+            glyphs = std::make_shared<const std::vector<glyph>>(std::move(*cached));
+        }
+    }
+    if (!glyphs) {
+        glyph_output_dev dev;
+        document.displayPage(&dev, page, 72, 72, 0, false, true, false, abort_check, const_cast<cancel_token *>(&token));
+        // la pagina interrotta e' incompleta, non va in cache
+        token.check();
+        glyphs = std::make_shared<const std::vector<glyph>>(dev.take_glyphs());
+        if (m_cache) {
+            m_cache->store_glyphs(m_content_digest, page, *glyphs);
+        }
+    }
+
+    std::scoped_lock lock(m_text_mutex);
+    return m_glyph_pages.emplace(page, std::move(glyphs)).first->second;
+}
+
+std::string pdf_document::read_text(PDFDoc &document, const pdf_rect &rect, const cancel_token &token) const {
+    const double w = document.getPageCropWidth(rect.page);
+    const double h = document.getPageCropHeight(rect.page);
+
+    if (m_raw_glyphs && rect.mode == read_mode::RAW) {
+        return assemble_raw_text(*page_glyphs(document, rect.page, token),
+            rect.x * w, rect.y * h, (rect.x + rect.w) * w, (rect.y + rect.h) * h);
+    }
+
     std::string ret;
-    if (!isopen() || rect.page > num_pages() || rect.page < 1) return ret;
 
     TextOutputDev td([](void *stream, const char *text, int len) {
         static_cast<std::string *>(stream)->append(text, len);
@@ -81,29 +304,56 @@ std::string pdf_document::get_text(const pdf_rect &rect) const {
     td.setTextEOL(eolUnix);
     td.setTextPageBreaks(false);
 
-    const double w = m_document->getPageCropWidth(rect.page);
-    const double h = m_document->getPageCropHeight(rect.page);
-
-    m_document->displayPageSlice(&td, rect.page, 72, 72, 0, false, true, false,
-        rect.x * w, rect.y * h, rect.w * w, rect.h * h);
+    document.displayPageSlice(&td, rect.page, 72, 72, 0, false, true, false,
+        rect.x * w, rect.y * h, rect.w * w, rect.h * h, abort_check, const_cast<cancel_token *>(&token));
+    token.check();
     return ret;
 }
 
-std::string pdf_document::get_page_text(const pdf_rect &rect) const {
-    return get_text(pdf_rect(0.0, 0.0, 1.0, 1.0, rect.page, rect.mode));
+void pdf_document::prefetch(std::span<const pdf_rect> rects) const {
+    std::vector<pdf_rect> pending;
+    for (const auto &rect : rects) {
+        if (!isopen() || rect.page > num_pages() || rect.page < 1) continue;
+        pending.push_back(rect);
+    }
+
+    std::scoped_lock lock(m_prefetch_mutex);
+    m_prefetch_stop.request_stop();
+    m_prefetch_stop = {};
+
+    // senza thread di estrazione i rettangoli vengono letti da un solo thread
+    if (m_extract_threads.empty()) {
+        m_prefetch_thread = std::jthread([this, pending = std::move(pending)](std::stop_token stop) {
+            cancel_token token{stop};
+            try {
+                for (const auto &rect : pending) {
+                    cached_text(rect, token);
+                }
+            } catch (const pdf_cancelled &) {}
+        });
+    } else {
+        m_prefetch_rects = std::move(pending);
+        m_prefetch_next = 0;
+        m_prefetch_ready.notify_all();
+    }
 }
 
-pdf_image pdf_document::render_page(int page, int rotation) const {
+pdf_image pdf_document::render_page(int page, int rotation, const cancel_token &token) const {
+    // senza documento non ci sono istanze da riservare, lease_document aspetterebbe per sempre
+    if (!isopen() || page > num_pages() || page < 1) return {};
+    auto document = lease_document(token);
     SplashColor white{0xff, 0xff, 0xff};
     SplashOutputDev dev(splashModeRGB8, 3, false, white, true);
     dev.setFontAntialias(true);
     dev.setVectorAntialias(true);
-    dev.startDoc(m_document.get());
+    dev.startDoc(document.get());
 
     constexpr double resolution = 150.0;
 
-    m_document->displayPage(&dev, page, resolution, resolution, rotation * 90, false, true, false);
+    document->displayPage(&dev, page, resolution, resolution, rotation * 90, false, true, false,
+        abort_check, const_cast<cancel_token *>(&token));
+    token.check();
 
     SplashBitmap *bitmap = dev.getBitmap();
     return pdf_image(bitmap->getWidth(), bitmap->getHeight(), bitmap->takeData());
-}
\ No newline at end of file
+}
@@ -5,13 +5,25 @@
 #include <string>
 #include <memory>
 #include <tuple>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <span>
 #include <filesystem>
 
 #include <PDFDoc.h>
 
 #include "utils/utils.h"
+#include "glyph_output_dev.h"
+#include "utils/sha256.h"
 
 namespace bls {
+    class page_cache;
+
     DEFINE_ENUM(read_mode,
         (DEFAULT)
         (LAYOUT)
@@ -24,6 +36,39 @@ namespace bls {
         read_mode mode = read_mode::DEFAULT;
 
         void rotate(int amt);
+
+        auto operator <=> (const pdf_rect &other) const = default;
+    };
+
+    // lanciata quando una lettura del documento viene interrotta
+    struct pdf_cancelled {};
+
+    // passato a poppler, che lo controlla durante il disegno della pagina
+    class cancel_token {
+    public:
+        cancel_token() = default;
+        explicit cancel_token(const std::atomic<bool> &flag,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+            : m_flag(&flag), m_deadline(deadline) {}
+        explicit cancel_token(std::stop_token stop) : m_stop(std::move(stop)) {}
+
+        bool cancelled() const {
+            return (m_flag && *m_flag) || m_stop.stop_requested() || expired();
+        }
+
+        bool expired() const {
+            return m_deadline != std::chrono::steady_clock::time_point::max()
+                && std::chrono::steady_clock::now() > m_deadline;
+        }
+
+        void check() const {
+            if (cancelled()) throw pdf_cancelled{};
+        }
+
+    private:
+        const std::atomic<bool> *m_flag = nullptr;
+        std::stop_token m_stop;
+        std::chrono::steady_clock::time_point m_deadline = std::chrono::steady_clock::time_point::max();
     };
 
     class pdf_image {
@@ -67,34 +112,132 @@ namespace bls {
         unsigned char *release() { return std::exchange(m_data, nullptr); }
     };
 
-    class pdf_document {
+    // testo di un documento letto dal reader, aperto con poppler o registrato in precedenza
+    class document_source {
+    public:
+        virtual ~document_source() = default;
+
+        virtual std::filesystem::path filename() const = 0;
+
+        virtual int num_pages() const = 0;
+
+        // se token viene interrotto lanciano pdf_cancelled, anche durante le chiamate a poppler
+        virtual std::string get_text(const pdf_rect &rect, const cancel_token &token = {}) const = 0;
+
+        std::string get_page_text(const pdf_rect &rect, const cancel_token &token = {}) const {
+            return get_text(pdf_rect(0.0, 0.0, 1.0, 1.0, rect.page, rect.mode), token);
+        }
+
+        // legge in background il testo dei rettangoli e lo mette in cache,
+        // interrompe la lettura anticipata precedente
+        virtual void prefetch(std::span<const pdf_rect>) const {}
+    };
+
+    class pdf_document : public document_source {
     public:
         pdf_document() = default;
 
-        explicit pdf_document(const std::filesystem::path &filename) {
-            open(filename);
+        explicit pdf_document(const std::filesystem::path &filename, size_t extract_threads = 0) {
+            open(filename, extract_threads);
         }
 
-        void open(const std::filesystem::path &filename);
+        // Se extract_threads > 0 apre altre extract_threads istanze del file, su cui le letture
+        // possono avvenire in parallelo, e i rettangoli passati a prefetch vengono letti
+        // da extract_threads thread mentre il layout viene eseguito.
+        // Le letture usano sempre le stesse chiamate a poppler: il testo non dipende dal numero di thread
+        void open(const std::filesystem::path &filename, size_t extract_threads = 0);
+
+        // il testo letto viene cercato e salvato anche nella cache su disco,
+        // se il documento e' gia' aperto viene riaperto
+        void set_cache(std::shared_ptr<page_cache> cache);
+
+        // Se attivo in modalita' RAW il testo viene composto dai caratteri disegnati nella pagina,
+        // estratti una volta sola, invece di rileggere ogni rettangolo con TextOutputDev.
+        // E' piu' veloce, ma spazi e a capo vengono ricostruiti dalle posizioni dei caratteri
+        // e il testo puo' essere diverso da quello di TextOutputDev
+        void set_raw_glyphs(bool value) {
+            m_raw_glyphs = value;
+        }
 
         bool isopen() const { return m_document != nullptr; }
 
-        std::filesystem::path filename() const {
+        std::filesystem::path filename() const override {
             return m_document->getFileName()->toStr();
         }
         
-        int num_pages() const {
-            return m_document->getNumPages();
+        int num_pages() const override {
+            return m_num_pages;
         }
 
-        std::string get_text(const pdf_rect &rect) const;
-        
-        std::string get_page_text(const pdf_rect &rect) const;
+        std::string get_text(const pdf_rect &rect, const cancel_token &token = {}) const override;
+
+        // ritorna un'immagine vuota se il documento non e' aperto o la pagina non esiste
+        pdf_image render_page(int page, int rotation = 0, const cancel_token &token = {}) const;
+
+        void prefetch(std::span<const pdf_rect> rects) const override;
+
+        // inizializza i parametri globali di poppler, viene chiamata da open
+        static void init_poppler();
+
+    private:
+        // restituisce l'istanza di poppler a pdf_document quando viene distrutto
+        struct document_release {
+            const pdf_document *owner;
+            void operator()(PDFDoc *document) const;
+        };
+
+        using document_lease = std::unique_ptr<PDFDoc, document_release>;
+
+        // aspetta un'istanza di poppler libera e la riserva al thread corrente
+        document_lease lease_document(const cancel_token &token) const;
+
+        std::string cached_text(const pdf_rect &rect, const cancel_token &token) const;
+        std::string load_text(const pdf_rect &rect, const cancel_token &token) const;
+        std::string read_text(PDFDoc &document, const pdf_rect &rect, const cancel_token &token) const;
+
+        using glyph_page = std::shared_ptr<const std::vector<glyph>>;
+        glyph_page page_glyphs(PDFDoc &document, int page, const cancel_token &token) const;
+
+        // ferma i thread in background e chiude tutte le istanze di poppler
+        void close();
 
-        pdf_image render_page(int page, int rotation = 0) const;
+        void extract_thread(std::stop_token stop, std::filesystem::path filename);
         
     private:
         std::unique_ptr<PDFDoc> m_document;
+        int m_num_pages = 0;
+
+        std::shared_ptr<page_cache> m_cache;
+        util::sha256_digest m_content_digest{};
+
+        bool m_raw_glyphs = false;
+
+        // poppler non e' thread safe: ogni istanza viene usata da un thread alla volta.
+        // Le istanze aperte dai thread di estrazione si aggiungono a m_document
+        std::vector<std::unique_ptr<PDFDoc>> m_extra_documents;
+        mutable std::vector<PDFDoc *> m_free_documents;
+        mutable std::mutex m_documents_mutex;
+        mutable std::condition_variable m_document_released;
+
+        // Il documento puo' essere letto da piu' reader in parallelo, il testo letto viene condiviso.
+        // Una lettura in corso e' in cache come future, le altre letture dello stesso rettangolo la aspettano
+        mutable std::mutex m_text_mutex;
+        mutable std::map<pdf_rect, std::shared_future<std::string>> m_text_cache;
+
+        // caratteri di ogni pagina letta in modalita' RAW con m_raw_glyphs, estratti una volta sola
+        mutable std::map<int, glyph_page> m_glyph_pages;
+
+        // rettangoli dell'ultima chiamata a prefetch, letti dai thread di estrazione in ordine.
+        // m_prefetch_stop interrompe le letture della chiamata precedente
+        mutable std::mutex m_prefetch_mutex;
+        mutable std::condition_variable_any m_prefetch_ready;
+        mutable std::vector<pdf_rect> m_prefetch_rects;
+        mutable size_t m_prefetch_next = 0;
+        mutable std::stop_source m_prefetch_stop;
+
+        // dichiarati per ultimi, vengono fermati prima di distruggere le istanze di poppler
+        std::vector<std::jthread> m_extract_threads;
+        mutable std::jthread m_prefetch_thread;
     };
 
 }
@@ -0,0 +1,115 @@
+#include "read_plan.h"
+
+#include <optional>
+#include <set>
+
+using namespace bls;
+
+void bls::move_box(pdf_rect &box, spacer_index idx, const variable &amt) {
+    switch (idx) {
+    case spacer_index::PAGE:
+        box.page += amt.as_int(); break;
+    case spacer_index::ROTATE:
+        box.rotate(amt.as_int()); break;
+    case spacer_index::X:
+        box.x += amt.as_double(); break;
+    case spacer_index::Y:
+        box.y += amt.as_double(); break;
+    case spacer_index::WIDTH:
+    case spacer_index::RIGHT:
+        box.w += amt.as_double(); break;
+    case spacer_index::HEIGHT:
+    case spacer_index::BOTTOM:
+        box.h += amt.as_double(); break;
+    case spacer_index::TOP:
+        box.y += amt.as_double();
+        box.h -= amt.as_double();
+        break;
+    case spacer_index::LEFT:
+        box.x += amt.as_double();
+        box.w -= amt.as_double();
+        break;
+    }
+}
+
+std::vector<pdf_rect> bls::read_plan(const command_list &code) {
+    // nei punti di arrivo dei salti il rettangolo dipende dal percorso
+    std::set<const command_args *> targets;
+    for (const auto &cmd : code) {
+        visit_command(util::overloaded{
+            []<opcode Cmd>(command_tag<Cmd>) {},
+            []<opcode Cmd>(command_tag<Cmd>, const auto &) {},
+            [&]<opcode Cmd>(command_tag<Cmd>, command_node node) {
+                targets.insert(&*node);
+            }
+        }, cmd);
+    }
+
+    std::vector<pdf_rect> plan;
+    std::set<pdf_rect> found;
+    auto add_read = [&](const pdf_rect &rect) {
+        if (found.insert(rect).second) {
+            plan.push_back(rect);
+        }
+    };
+
+    std::optional<pdf_rect> box;
+    std::optional<variable> literal;
+    for (const auto &cmd : code) {
+        if (targets.contains(&cmd)) {
+            box.reset();
+        }
+        auto value = std::exchange(literal, std::nullopt);
+
+        visit_command(util::overloaded{
+            []<opcode Cmd>(command_tag<Cmd>) {},
+            []<opcode Cmd>(command_tag<Cmd>, const auto &) {},
+            // le funzioni chiamate e gli import possono spostare il rettangolo,
+            // dopo JMP e RET si arriva solo con un salto
+            [&](command_tag<opcode::JMP>, command_node) { box.reset(); },
+            [&](command_tag<opcode::JSR>, command_node) { box.reset(); },
+            [&](command_tag<opcode::JSRVAL>, command_node) { box.reset(); },
+            [&](command_tag<opcode::IMPORT>, const std::string &) { box.reset(); },
+            [&](command_tag<opcode::RET>) { box.reset(); },
+            [&](command_tag<opcode::SETBOX>, const pdf_rect &rect) {
+                box = rect;
+            },
+            [&](command_tag<opcode::MVBOX>, spacer_index idx) {
+                if (box && value) {
+                    move_box(*box, idx, *value);
+                } else {
+                    box.reset();
+                }
+            },
+            [&](command_tag<opcode::MVNBOX>, spacer_index idx) {
+                if (box && value) {
+                    move_box(*box, idx, -*value);
+                } else {
+                    box.reset();
+                }
+            },
+            [&](command_tag<opcode::PUSHNUM>, fixed_point num) {
+                literal = num;
+            },
+            [&](command_tag<opcode::PUSHINT>, int64_t num) {
+                literal = num;
+            },
+            [&](command_tag<opcode::PUSHDOUBLE>, double num) {
+                literal = num;
+            },
+            [&](command_tag<opcode::RDBOX>, read_mode mode) {
+                if (box) {
+                    box->mode = mode;
+                    add_read(*box);
+                }
+            },
+            [&](command_tag<opcode::RDPAGE>, read_mode mode) {
+                if (box) {
+                    box->mode = mode;
+                    add_read(pdf_rect(0.0, 0.0, 1.0, 1.0, box->page, mode));
+                }
+            },
+        }, cmd);
+    }
+    return plan;
+}
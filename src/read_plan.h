@@ -0,0 +1,22 @@
+#ifndef __READ_PLAN_H__
+#define __READ_PLAN_H__
+
+#include <vector>
+
+#include "bytecode.h"
+#include "variable.h"
+
+namespace bls {
+
+    // sposta il rettangolo come MVBOX, usata anche dal reader
+    void move_box(pdf_rect &box, spacer_index idx, const variable &amt);
+
+    // Ricava dal codice le letture con pagina e rettangolo costanti,
+    // cioe' i SETBOX seguiti solo da MVBOX e MVNBOX con argomenti letterali.
+    // Le letture sono nell'ordine del codice e senza ripetizioni, comprese quelle nei rami condizionali,
+    // che quindi potrebbero non essere eseguite. Il codice dei file importati non viene considerato.
+    std::vector<pdf_rect> read_plan(const command_list &code);
+
+}
+
+#endif
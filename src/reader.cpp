@@ -2,30 +2,72 @@
 
 #include "parser.h"
 #include "bytecode_printer.h"
+#include "native_module.h"
+#include "read_plan.h"
 
 #include <boost/locale.hpp>
 
+#include <mutex>
+#include <thread>
+
 using namespace bls;
 
+void bls::warm_up() {
+    std::jthread poppler_thread(pdf_document::init_poppler);
+    std::jthread calendar_thread(datetime::calendar_locale);
+    intl::messages_locale();
+}
+
 void reader::clear() {
     m_code.clear();
+    m_imports.clear();
+    m_stack_depths = {};
+    m_read_plan.clear();
+    set_native_module(nullptr);
     m_flags.clear();
     m_doc = nullptr;
 }
 
-void reader::start() {
+void reader::start(std::stop_token stop) {
     m_values.clear();
     m_globals.clear();
     m_notes.clear();
     m_layouts.clear();
+    m_memo.clear();
     m_stack.clear();
     m_views.clear();
     m_selected.clear();
+    m_calls.clear();
+
+    // i file importati modificati dopo la lettura precedente vengono ricaricati,
+    // qui nessuna chiamata punta piu' al loro codice
+    std::erase_if(m_imports, [](const auto &item) {
+        std::error_code ec;
+        return std::filesystem::last_write_time(item.first, ec) != item.second.mtime;
+    });
+
+    reserve_stacks();
+
+    // il documento legge in background le pagine che servono al layout
+    if (m_doc && !m_flags.check(reader_flags::FIND_LAYOUT)) {
+        m_doc->prefetch(m_read_plan);
+    }
+
+    // non ci sono piu' variabili della lettura precedente
+    m_arena.release();
+    m_arena_counter.reset_counters();
+    m_upstream.reset_counters();
+
+    // il limite va sulle variabili in uso, la memoria liberata durante la lettura viene riusata
+    m_arena_counter.set_limit(m_limits.max_memory);
+
+    util::resource_scope arena_scope{&m_arena_counter};
+
+    m_globals = variable_map{};
 
     m_values.emplace_back();
     m_current_table = m_values.begin();
 
-    m_calls.clear();
     m_calls.emplace();
 
     m_box_name = nullptr;
@@ -33,19 +75,34 @@ void reader::start() {
 
     m_current_box = {};
 
-    m_locale = std::locale::classic();
-
     m_program_counter = m_program_counter_next = m_code.begin();
 
     m_running = true;
     m_aborted = false;
+    m_found_layout = false;
+
+    // viene registrata dopo aver azzerato lo stato, se stop e' gia' stato richiesto chiama subito abort()
+    std::stop_callback stop_callback(stop, [this] { abort(); });
+
+    m_instruction_count = 0;
+    if (m_limits.timeout.count() > 0) {
+        m_deadline = std::chrono::steady_clock::now() + m_limits.timeout;
+    } else {
+        m_deadline = std::chrono::steady_clock::time_point::max();
+    }
 
     try {
-        while (m_running) {
-            m_program_counter_next = std::next(m_program_counter);
-            exec_command(*m_program_counter);
-            m_program_counter = m_program_counter_next;
+        if (m_native) {
+            native_context ctx{*this};
+            m_native->run(ctx);
+        } else {
+            run_until(m_code.end());
         }
+    } catch (const pdf_cancelled &) {
+        // la lettura del documento e' stata interrotta da abort() o dal tempo massimo
+        if (!m_aborted) check_limits();
+    } catch (const util::quota_exceeded &) {
+        throw reader_limit_error(reader_limit::MEMORY, intl::translate("MEMORY_LIMIT_EXCEEDED", m_limits.max_memory));
     } catch (const layout_error &err) {
         if (m_box_name && m_last_line) {
             throw reader_error(std::format("{}: {}\n{}", *m_box_name, *m_last_line, err.what()));
@@ -60,33 +117,6 @@ void reader::start() {
     m_running = false;
 }
 
-static void move_box(pdf_rect &box, spacer_index idx, const variable &amt) {
-    switch (idx) {
-    case spacer_index::PAGE:
-        box.page += amt.as_int(); break;
-    case spacer_index::ROTATE:
-        box.rotate(amt.as_int()); break;
-    case spacer_index::X:
-        box.x += amt.as_double(); break;
-    case spacer_index::Y:
-        box.y += amt.as_double(); break;
-    case spacer_index::WIDTH:
-    case spacer_index::RIGHT:
-        box.w += amt.as_double(); break;
-    case spacer_index::HEIGHT:
-    case spacer_index::BOTTOM:
-        box.h += amt.as_double(); break;
-    case spacer_index::TOP:
-        box.y += amt.as_double();
-        box.h -= amt.as_double();
-        break;
-    case spacer_index::LEFT:
-        box.x += amt.as_double();
-        box.w -= amt.as_double();
-        break;
-    }
-}
-
 static void to_subitem(variable &var, size_t idx) {
     if (var.is_array()) {
         const auto &arr = var.deref().as_array();
@@ -102,26 +132,197 @@ static void to_subitem(variable &var, size_t idx) {
     var = variable();
 }
 
+// il bytecode viene verificato prima di essere eseguito
+command_list bls::compile_layout(const layout_box_list &layout, stack_depths &depths) {
+    parser my_parser{parser_flags::OPTIMIZE_LABELS};
+    my_parser.add_flags(parser_flags::TYPED_OPCODES);
+    auto code = my_parser(layout);
+    depths = verify_bytecode(code);
+    return code;
+}
+
+// cache dei layout importati, condivisa tra tutti i reader.
+// Il codice compilato non viene piu' modificato
+static std::mutex s_imports_mutex;
+static std::map<std::filesystem::path, import_entry> s_imports;
+
+static import_entry load_import(const std::filesystem::path &filename) {
+    auto path = std::filesystem::weakly_canonical(filename);
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+
+    {
+        std::scoped_lock lock(s_imports_mutex);
+        auto it = s_imports.find(path);
+        if (it != s_imports.end() && it->second.mtime == mtime) {
+            return it->second;
+        }
+    }
+
+    // la compilazione avviene fuori dal lock per non bloccare gli altri reader,
+    // se due reader compilano lo stesso file viene tenuto il primo risultato pubblicato
+    import_entry entry{mtime, nullptr, {}};
+    entry.code = std::make_shared<command_list>(compile_layout(layout_box_list(filename), entry.depths));
+
+    std::scoped_lock lock(s_imports_mutex);
+    auto &published = s_imports[path];
+    if (!published.code || published.mtime != mtime) {
+        published = std::move(entry);
+    }
+    return published;
+}
+
+// cache dei locale generati da boost, condivisa tra tutti i reader
+static std::mutex s_locales_mutex;
+static std::map<std::string, std::locale, std::less<>> s_locales;
+
+static std::locale get_locale(const std::string &lang) {
+    std::scoped_lock lock(s_locales_mutex);
+    auto it = s_locales.find(lang);
+    if (it == s_locales.end()) {
+        it = s_locales.emplace(lang, boost::locale::generator{}(lang)).first;
+    }
+    return it->second;
+}
+
 command_node reader::add_layout(const layout_box_list &layout) {
-    auto new_code = parser{parser_flags::OPTIMIZE_LABELS}(layout);
+    stack_depths depths;
+    auto new_code = compile_layout(layout, depths);
+    m_stack_depths |= depths;
+
+    auto plan = read_plan(new_code);
+    m_read_plan.insert(m_read_plan.end(), plan.begin(), plan.end());
 
     auto loc = new_code.begin();
     m_code.string_data.splice(m_code.string_data.end(), std::move(new_code.string_data));
     m_code.splice(m_code.end(), std::move(new_code));
+
+    // il modulo nativo non comprende il codice aggiunto
+    set_native_module(nullptr);
     return loc;
 }
 
+command_node reader::add_import(const std::filesystem::path &filename) {
+    auto path = m_code.string_data.emplace(m_code.string_data.end(), std::filesystem::absolute(filename).string());
+    auto loc = m_code.insert(m_code.end(), make_command<opcode::IMPORT>(path));
+    m_code.push_back(make_command<opcode::RET>());
+
+    set_native_module(nullptr);
+    return loc;
+}
+
+bool reader::set_native_module(std::shared_ptr<const native_module> module) {
+    m_native = nullptr;
+    m_native_nodes.clear();
+    m_native_indices.clear();
+    if (!module || module->code_hash() != util::to_hex(bytecode_hash(m_code))) {
+        return false;
+    }
+    for (auto it = m_code.begin(); it != m_code.end(); ++it) {
+        m_native_indices.emplace(&*it, m_native_nodes.size());
+        m_native_nodes.push_back(it);
+    }
+    m_native = std::move(module);
+    return true;
+}
+
 variable reader::do_function_call(const command_call &call) {
-    if (call->second.minargs == call->second.maxargs) {
-        m_numargs = call->second.minargs;
+    auto args = arg_list(m_stack).last(call.numargs);
+    auto ret = call->second(this, args);
+    // il risultato puo' puntare dentro agli argomenti, che vengono tolti dallo stack
+    for (const auto &arg : args) {
+        ret.detach_from(arg);
     }
-    auto ret = call->second(this, arg_list(m_stack.end() - m_numargs, m_stack.end()));
-    m_stack.resize(m_stack.size() - m_numargs);
+    m_stack.resize(m_stack.size() - call.numargs);
     return ret;
 }
 
-void reader::exec_command(const command_args &cmd) {
-    visit_command(util::overloaded{
+// una regex e una stringa con lo stesso testo danno risultati diversi
+static bool is_regex(const variable &var) {
+    return var.type() == variable_type::STRING && var.as_view().flags.is_regex;
+}
+
+bool memo_key::operator == (const memo_key &other) const {
+    return fun == other.fun && std::ranges::equal(args, other.args, [](const variable &lhs, const variable &rhs) {
+        return lhs.type() == rhs.type() && is_regex(lhs) == is_regex(rhs) && lhs == rhs;
+    });
+}
+
+size_t memo_key_hash::operator()(const memo_key &key) const {
+    size_t ret = std::hash<const command_args *>{}(key.fun);
+    for (const auto &arg : key.args) {
+        if (arg.type() == variable_type::STRING) {
+            ret = ret * 31 + std::hash<std::string_view>{}(arg.as_view());
+        } else {
+            ret = ret * 31 + std::hash<std::string>{}(arg.as_string());
+        }
+        ret = ret * 31 + is_regex(arg);
+    }
+    return ret;
+}
+
+// copia il valore in modo che le stringhe non dipendano da altre variabili
+static variable make_owned(const variable &var) {
+    if (var.deref().type() == variable_type::STRING) {
+        auto str = var.as_view();
+        return variable(std::string(str), str.flags);
+    }
+    return var.deref();
+}
+
+void reader::memo_lookup(size_t numargs) {
+    memo_key key{&*m_program_counter, {}};
+    for (auto it = m_stack.end() - numargs; it != m_stack.end(); ++it) {
+        // gli array non vengono messi in cache
+        if (it->is_array()) return;
+        if (it->deref().type() == variable_type::STRING) {
+            auto str = it->as_view();
+            key.args.emplace_back(std::string_view(str), str.flags);
+        } else {
+            key.args.push_back(it->deref());
+        }
+    }
+    if (auto it = m_memo.find(key); it != m_memo.end()) {
+        m_stack.resize(m_stack.size() - numargs);
+        auto fun_call = m_calls.pop();
+        jump_to(fun_call->return_addr);
+        if (fun_call->getretvalue) {
+            m_stack.push(it->second);
+        }
+    } else {
+        for (auto &arg : key.args) {
+            arg = make_owned(arg);
+        }
+        m_calls.top().memo = std::move(key);
+    }
+}
+
+void reader::reserve_stacks() {
+    m_stack.reserve(m_stack_depths.values);
+    m_views.reserve(m_stack_depths.views);
+    m_selected.reserve(m_stack_depths.selected);
+}
+
+void reader::run_until(command_node stop) {
+    while (m_running && m_program_counter_next != stop) {
+        m_program_counter = m_program_counter_next;
+        m_program_counter_next = std::next(m_program_counter);
+        exec_command(*m_program_counter);
+        count_instruction();
+    }
+}
+
+void reader::check_limits() const {
+    if (m_limits.max_instructions && m_instruction_count > m_limits.max_instructions) {
+        throw reader_limit_error(reader_limit::INSTRUCTIONS, intl::translate("INSTRUCTION_LIMIT_EXCEEDED", m_limits.max_instructions));
+    }
+    if (std::chrono::steady_clock::now() > m_deadline) {
+        throw reader_limit_error(reader_limit::TIMEOUT, intl::translate("TIMEOUT_EXCEEDED", m_limits.timeout.count()));
+    }
+}
+
+auto reader::command_handlers() {
+    return util::overloaded{
         [](command_tag<opcode::NOP>) {},
         [](command_tag<opcode::LABEL>, auto) {},
         [this](command_tag<opcode::BOXNAME>, const std::string &name) {
@@ -130,8 +331,8 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::COMMENT>, const std::string &line) {
             m_last_line = &line;
         },
-        [this](command_tag<opcode::NEWBOX>) {
-            m_current_box = {};
+        [this](command_tag<opcode::SETBOX>, const pdf_rect &rect) {
+            m_current_box = rect;
         },
         [this](command_tag<opcode::MVBOX>, spacer_index idx) {
             move_box(m_current_box, idx, *m_stack.pop());
@@ -141,11 +342,11 @@ void reader::exec_command(const command_args &cmd) {
         },
         [this](command_tag<opcode::RDBOX>, read_mode mode) {
             m_current_box.mode = mode;
-            m_stack.emplace(get_document().get_text(m_current_box));
+            m_stack.emplace(get_document().get_text(m_current_box, document_token()));
         },
         [this](command_tag<opcode::RDPAGE>, read_mode mode) {
             m_current_box.mode = mode;
-            m_stack.emplace(get_document().get_page_text(m_current_box));
+            m_stack.emplace(get_document().get_page_text(m_current_box, document_token()));
         },
         [this](command_tag<opcode::SELVAR>, const std::string &name) {
             m_selected.emplace(*m_current_table, name);
@@ -202,6 +403,15 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::PUSHVAR>) {
             m_stack.push(m_selected.pop()->get_value());
         },
+        [this](command_tag<opcode::PUSHVARNAMED>, const std::string &name) {
+            m_stack.push(variable_selector::get_value(*m_current_table, name));
+        },
+        [this](command_tag<opcode::PUSHGLOBALNAMED>, const std::string &name) {
+            m_stack.push(variable_selector::get_value(m_globals, name));
+        },
+        [this](command_tag<opcode::PUSHLOCALNAMED>, const std::string &name) {
+            m_stack.push(variable_selector::get_value(m_calls.top().vars, name));
+        },
         [this](command_tag<opcode::PUSHVIEW>) {
             m_stack.push(m_views.top().view());
         },
@@ -238,8 +448,15 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::STKSWP>) {
             std::swap(m_stack.top(), *(m_stack.end() - 2));
         },
-        [this](command_tag<opcode::CALLARGS>, size_t numargs) {
-            m_numargs = numargs;
+        [this](command_tag<opcode::STKPICK>, size_t idx) {
+            // copia invece di un puntatore, lo stack puo' essere riallocato
+            variable var = *(m_stack.end() - 1 - idx);
+            m_stack.push(std::move(var));
+        },
+        [this](command_tag<opcode::STKDROP>, size_t num) {
+            auto top = std::move(*m_stack.pop()).deref();
+            m_stack.resize(m_stack.size() - num);
+            m_stack.push(std::move(top));
         },
         [this](command_tag<opcode::CALL>, const command_call &call) {
             m_stack.push(do_function_call(call));
@@ -247,6 +464,15 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::SYSCALL>, const command_call &call) {
             do_function_call(call);
         },
+        [this](command_tag<opcode::ADDINT>) {
+            int_operator(std::plus<>{});
+        },
+        [this](command_tag<opcode::SUBINT>) {
+            int_operator(std::minus<>{});
+        },
+        [this](command_tag<opcode::MULINT>) {
+            int_operator(std::multiplies<>{});
+        },
         [this](command_tag<opcode::VIEWADD>) {
             m_views.emplace(m_stack.top());
         },
@@ -273,6 +499,42 @@ void reader::exec_command(const command_args &cmd) {
                 jump_to(node);
             }
         },
+        [this](command_tag<opcode::JZEQ>, command_node node) {
+            jump_compare_false(node, std::equal_to<>{});
+        },
+        [this](command_tag<opcode::JZNEQ>, command_node node) {
+            jump_compare_false(node, std::not_equal_to<>{});
+        },
+        [this](command_tag<opcode::JZLT>, command_node node) {
+            jump_compare_false(node, std::less<>{});
+        },
+        [this](command_tag<opcode::JZGT>, command_node node) {
+            jump_compare_false(node, std::greater<>{});
+        },
+        [this](command_tag<opcode::JZLEQ>, command_node node) {
+            jump_compare_false(node, std::less_equal<>{});
+        },
+        [this](command_tag<opcode::JZGEQ>, command_node node) {
+            jump_compare_false(node, std::greater_equal<>{});
+        },
+        [this](command_tag<opcode::JZEQINT>, command_node node) {
+            jump_compare_int_false(node, std::equal_to<>{});
+        },
+        [this](command_tag<opcode::JZNEQINT>, command_node node) {
+            jump_compare_int_false(node, std::not_equal_to<>{});
+        },
+        [this](command_tag<opcode::JZLTINT>, command_node node) {
+            jump_compare_int_false(node, std::less<>{});
+        },
+        [this](command_tag<opcode::JZGTINT>, command_node node) {
+            jump_compare_int_false(node, std::greater<>{});
+        },
+        [this](command_tag<opcode::JZLEQINT>, command_node node) {
+            jump_compare_int_false(node, std::less_equal<>{});
+        },
+        [this](command_tag<opcode::JZGEQINT>, command_node node) {
+            jump_compare_int_false(node, std::greater_equal<>{});
+        },
         [this](command_tag<opcode::JVE>, command_node node) {
             if (m_views.top().ate()) {
                 jump_to(node);
@@ -284,6 +546,9 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::JSRVAL>, command_node node) {
             jump_subroutine(node, true);
         },
+        [this](command_tag<opcode::MEMOLOOKUP>, size_t numargs) {
+            memo_lookup(numargs);
+        },
         [this](command_tag<opcode::COPYRVAL>) {
             m_calls.top().return_value = m_stack.pop()->deref();
         },
@@ -294,6 +559,12 @@ void reader::exec_command(const command_args &cmd) {
             if (m_calls.size() > 1) {
                 auto fun_call = m_calls.pop();
                 jump_to(fun_call->return_addr);
+                if (fun_call->memo && !fun_call->return_value.is_pointer() && !fun_call->return_value.is_array()) {
+                    if (m_memo.size() >= max_memo_size) {
+                        m_memo.clear();
+                    }
+                    m_memo.emplace(std::move(*fun_call->memo), make_owned(fun_call->return_value));
+                }
                 if (fun_call->getretvalue) {
                     m_stack.push_back(std::move(fun_call->return_value));
                 }
@@ -302,16 +573,22 @@ void reader::exec_command(const command_args &cmd) {
             }
         },
         [this](command_tag<opcode::IMPORT>, const std::string &path) {
-            auto node = add_layout(layout_box_list(path));
-            *m_program_counter = make_command<opcode::JSR>(node);
-            jump_subroutine(node);
+            auto it = m_imports.find(path);
+            if (it == m_imports.end()) {
+                it = m_imports.emplace(path, load_import(path)).first;
+                // il codice importato parte dalla profondita' del chiamante, e' solo una stima
+                m_stack_depths |= it->second.depths;
+                reserve_stacks();
+            }
+            jump_subroutine(it->second.code->begin());
         },
         [this](command_tag<opcode::SETPATH>, const std::string &path) {
             m_current_layout = m_layouts.emplace(path).first;
         },
         [this](command_tag<opcode::SETLANG>, const std::string &lang) {
             try {
-                m_locale = boost::locale::generator{}(lang);
+                m_locale = get_locale(lang);
+                m_memo.clear();
             } catch (std::runtime_error) {
                 throw layout_error(intl::translate("UNSUPPORTED_LANGUAGE", lang));
             }
@@ -319,7 +596,23 @@ void reader::exec_command(const command_args &cmd) {
         [this](command_tag<opcode::FOUNDLAYOUT>) {
             if (m_flags.check(reader_flags::FIND_LAYOUT)) {
                 m_running = false;
+                m_found_layout = true;
             }
         },
-    }, cmd);
+    };
+}
+
+void reader::exec_command(const command_args &cmd) {
+    visit_command(command_handlers(), cmd);
+}
+
+template<opcode Cmd> void reader::exec_op(reader &self, const command_args &cmd) {
+    invoke_command<Cmd>(self.command_handlers(), cmd);
+}
+
+const reader::op_table &reader::native_ops() {
+    static constexpr auto ops = []<opcode ... Cmds>(enums::enum_sequence<Cmds ...>) {
+        return op_table{ &reader::exec_op<Cmds> ... };
+    }(enums::make_enum_sequence<opcode>());
+    return ops;
 }
\ No newline at end of file
@@ -4,11 +4,18 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <deque>
 #include <list>
+#include <memory>
 #include <atomic>
+#include <optional>
+#include <unordered_map>
+#include <chrono>
+#include <stop_token>
 
 #include "layout.h"
 #include "bytecode.h"
+#include "bytecode_verifier.h"
 #include "variable_selector.h"
 #include "variable_view.h"
 
@@ -18,12 +25,32 @@ DEFINE_ENUM_FLAGS(reader_flags,
     (FIND_LAYOUT)
 )
 
+// chiave della cache dei risultati delle funzioni pure
+struct memo_key {
+    const command_args *fun;
+    std::vector<variable> args;
+
+    bool operator == (const memo_key &other) const;
+};
+
+struct memo_key_hash {
+    size_t operator()(const memo_key &key) const;
+};
+
+using memo_cache = std::unordered_map<memo_key, variable, memo_key_hash>;
+
+// numero massimo di risultati in cache, oltre il quale viene svuotata
+static constexpr size_t max_memo_size = 4096;
+
 struct function_call {
     variable_map vars;
     command_node return_addr;
     variable return_value;
     bool getretvalue;
 
+    // impostata se il risultato va salvato nella cache
+    std::optional<memo_key> memo;
+
     function_call() : getretvalue(false) {}
 
     function_call(command_node return_addr, bool getretvalue = false)
@@ -33,17 +60,68 @@ struct function_call {
 
 struct reader_aborted{};
 
+DEFINE_ENUM(reader_limit,
+    (TIMEOUT)
+    (INSTRUCTIONS)
+    (CALL_DEPTH)
+    (MEMORY)
+)
+
+// limiti di una lettura, 0 vuol dire nessun limite
+struct reader_limits {
+    std::chrono::milliseconds timeout{0};
+    size_t max_instructions = 0;
+    size_t max_call_depth = 0;
+    size_t max_memory = 0;      // byte delle variabili in uso contemporaneamente
+};
+
+struct reader_limit_error : reader_error {
+    reader_limit limit;
+
+    template<typename T>
+    reader_limit_error(reader_limit limit, T &&message)
+        : reader_error(std::forward<T>(message))
+        , limit(limit) {}
+};
+
+// ogni quante istruzioni vengono controllati il tempo e il numero di istruzioni
+constexpr size_t limits_check_interval = 4096;
+
+// allocazioni delle variabili durante l'ultima lettura
+struct alloc_stats {
+    size_t allocations;         // allocazioni servite dall'arena
+    size_t bytes;
+    size_t chunk_allocations;   // blocchi richiesti dall'arena al sistema, anche quelli gia' liberati
+    size_t chunk_bytes;
+    size_t peak_bytes;          // massimo dei byte delle variabili in uso contemporaneamente
+};
+
+// inizializza in parallelo i locale e poppler, che altrimenti vengono creati al primo utilizzo
+void warm_up();
+
+// compila il layout con le ottimizzazioni usate dal reader e ne verifica il bytecode
+command_list compile_layout(const layout_box_list &layout, stack_depths &depths);
+
+// layout importato e compilato, con la data di modifica del file al momento della compilazione
+struct import_entry {
+    std::filesystem::file_time_type mtime;
+    std::shared_ptr<command_list> code;
+    stack_depths depths;
+};
+
+class native_module;
+
 class reader {
 public:
     reader() = default;
 
-    void set_document(const pdf_document &doc) {
+    void set_document(const document_source &doc) {
         m_doc = &doc;
     }
 
-    void set_document(pdf_document &&doc) = delete;
+    void set_document(document_source &&doc) = delete;
     
-    const pdf_document &get_document() const {
+    const document_source &get_document() const {
         if (m_doc) {
             return *m_doc;
         } else {
@@ -54,18 +132,45 @@ public:
     // ritorna l'indirizzo del codice aggiunto
     command_node add_layout(const layout_box_list &layout);
 
+    // aggiunge un import del file, il codice compilato viene condiviso tra i reader
+    command_node add_import(const std::filesystem::path &filename);
+
+    // esegue il codice compilato da blsaot al posto dell'interprete.
+    // Ritorna false e continua ad interpretare se il modulo non corrisponde al codice caricato,
+    // va chiamato dopo add_layout
+    bool set_native_module(std::shared_ptr<const native_module> module);
+
     void add_flag(reader_flags flag) {
         m_flags.set(flag);
     }
 
+    // superati i limiti start() lancia reader_limit_error
+    void set_limits(const reader_limits &limits) {
+        m_limits = limits;
+    }
+
     void clear();
-    void start();
+
+    // una richiesta su stop interrompe la lettura come abort(), anche se arriva prima dell'inizio
+    void start(std::stop_token stop = {});
 
     const auto &get_values() const { return m_values; }
     const auto &get_notes() const { return m_notes; }
     const auto &get_layouts() const { return m_layouts; }
     const auto &get_current_layout() const { return *m_current_layout; }
 
+    // vero se la lettura e' stata fermata da FOUNDLAYOUT
+    bool found_layout() const { return m_found_layout; }
+
+    alloc_stats get_alloc_stats() const {
+        return {
+            m_arena_counter.allocations(), m_arena_counter.bytes(),
+            m_upstream.allocations(), m_upstream.bytes(),
+            m_arena_counter.peak_bytes()
+        };
+    }
+
+    // interrompe anche le letture del documento in corso
     void abort() {
         m_running = false;
         m_aborted = true;
@@ -77,17 +182,86 @@ private:
     }
 
     void jump_subroutine(command_node node, bool getretvalue = false) {
+        if (m_limits.max_call_depth && m_calls.size() > m_limits.max_call_depth) {
+            throw reader_limit_error(reader_limit::CALL_DEPTH, intl::translate("CALL_DEPTH_EXCEEDED", m_limits.max_call_depth));
+        }
         m_calls.emplace(std::next(m_program_counter), getretvalue);
         jump_to(node);
     }
 
+    void count_instruction() {
+        if (++m_instruction_count % limits_check_interval == 0) {
+            check_limits();
+        }
+    }
+
+    void check_limits() const;
+
+    cancel_token document_token() const {
+        return cancel_token{m_aborted, m_deadline};
+    }
+
     variable do_function_call(const command_call &call);
 
+    template<typename Compare> void jump_compare_false(command_node node, Compare compare) {
+        bool result = compare(*(m_stack.end() - 2), m_stack.top());
+        m_stack.resize(m_stack.size() - 2);
+        if (!result) {
+            jump_to(node);
+        }
+    }
+
+    // versioni specializzate per INTEGER, se i tipi non corrispondono si usa l'operatore generico
+    template<typename Operator> void int_operator(Operator op) {
+        auto &lhs = *(m_stack.end() - 2);
+        const auto &rhs = m_stack.top();
+        if (auto *a = lhs.get_if<variable_type::INTEGER>(), *b = rhs.get_if<variable_type::INTEGER>(); a && b) {
+            lhs = variable(op(*a, *b));
+        } else {
+            lhs = op(lhs.deref(), rhs.deref());
+        }
+        m_stack.resize(m_stack.size() - 1);
+    }
+
+    template<typename Compare> void jump_compare_int_false(command_node node, Compare compare) {
+        jump_compare_false(node, [&](const variable &lhs, const variable &rhs) {
+            if (auto *a = lhs.get_if<variable_type::INTEGER>(), *b = rhs.get_if<variable_type::INTEGER>(); a && b) {
+                return compare(*a, *b);
+            }
+            return compare(lhs, rhs);
+        });
+    }
+
+    void memo_lookup(size_t numargs);
+
+    void reserve_stacks();
+
     void exec_command(const command_args &cmd);
 
+    // esegue i comandi fino a stop o alla fine della lettura
+    void run_until(command_node stop);
+
+    auto command_handlers();
+
+    template<opcode Cmd> static void exec_op(reader &self, const command_args &cmd);
+
+    // una funzione per ogni opcode, chiamate direttamente dal codice nativo
+    using op_table = std::array<void (*)(reader &, const command_args &), enums::num_members_v<opcode>>;
+    static const op_table &native_ops();
+
 private:
+    // le variabili di una lettura vengono allocate qui e liberate tutte insieme alla successiva,
+    // va dichiarata prima dei membri che contengono variabili per essere distrutta dopo.
+    // I blocchi liberati durante la lettura vengono riusati, quelli grandi tornano subito al sistema
+    util::counting_resource m_upstream{std::pmr::new_delete_resource()};
+    std::pmr::unsynchronized_pool_resource m_arena{&m_upstream};
+    util::counting_resource m_arena_counter{&m_arena};
+
     command_list m_code;
 
+    // layout importati, il codice e' condiviso con gli altri reader
+    std::map<std::string, import_entry, std::less<>> m_imports;
+
     std::list<variable_map> m_values;
     std::list<variable_map>::iterator m_current_table;
 
@@ -95,20 +269,31 @@ private:
 
     util::simple_stack<variable> m_stack;
     util::simple_stack<variable_view> m_views;
-    util::simple_stack<function_call> m_calls;
     util::simple_stack<variable_selector> m_selected;
 
+    // i selettori tengono un riferimento alle variabili locali della chiamata in cima
+    // mentre viene calcolato il valore da assegnare, che puo' chiamare altre funzioni:
+    // gli elementi non devono spostarsi in memoria
+    util::simple_stack<function_call, std::deque<function_call>> m_calls;
+
+    // profondita' degli stack calcolata dal verificatore, viene riservata all'inizio della lettura
+    stack_depths m_stack_depths;
+
+    // letture costanti dei layout aggiunti, vengono anticipate dal documento
+    std::vector<pdf_rect> m_read_plan;
+
     std::set<std::filesystem::path> m_layouts;
     std::set<std::filesystem::path>::const_iterator m_current_layout;
 
     const std::string *m_box_name;
     const std::string *m_last_line;
-    size_t m_numargs;
 
     std::locale m_locale;
 
     std::vector<std::string> m_notes;
 
+    memo_cache m_memo;
+
     pdf_rect m_current_box;
 
     command_node m_program_counter;
@@ -116,11 +301,23 @@ private:
     
     std::atomic<bool> m_running = false;
     std::atomic<bool> m_aborted = false;
+    bool m_found_layout = false;
     enums::bitset<reader_flags> m_flags;
 
-    const pdf_document *m_doc = nullptr;
+    reader_limits m_limits;
+    size_t m_instruction_count = 0;
+    std::chrono::steady_clock::time_point m_deadline;
+
+    const document_source *m_doc = nullptr;
+
+    std::shared_ptr<const native_module> m_native;
+
+    // indirizzo di ogni comando nel codice nativo, i salti restano nel codice generato
+    std::vector<command_node> m_native_nodes;
+    std::unordered_map<const command_args *, size_t> m_native_indices;
 
     friend class function_lookup;
+    friend class native_context;
 };
 
 }
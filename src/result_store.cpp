@@ -0,0 +1,137 @@
+#include "result_store.h"
+
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <limits>
+
+#include "reader.h"
+#include "native_module.h"
+#include "utils/atomic_file.h"
+
+using namespace bls;
+
+namespace fs = std::filesystem;
+
+static void digest_file(const fs::path &filename, util::sha256 &hash, bool &reads_doc_filename, bool &reads_files, std::set<fs::path> &visited) {
+    // un layout importato due volte viene contato una volta sola
+    if (!visited.insert(fs::weakly_canonical(filename)).second) return;
+
+    stack_depths depths;
+    auto code = compile_layout(layout_box_list(filename), depths);
+    hash.update(util::to_hex(bytecode_hash(code)));
+
+    for (const auto &cmd : code) {
+        visit_command(util::overloaded{
+            []<opcode Cmd>(command_tag<Cmd>) {},
+            []<opcode Cmd>(command_tag<Cmd>, const auto &) {},
+            [&](command_tag<opcode::IMPORT>, const std::string &path) {
+                digest_file(path, hash, reads_doc_filename, reads_files, visited);
+            },
+            [&](command_tag<opcode::CALL>, const command_call &call) {
+                reads_doc_filename |= call->first == "doc_filename";
+                reads_files |= call->first == "readfile";
+            },
+            [&](command_tag<opcode::SYSCALL>, const command_call &call) {
+                reads_doc_filename |= call->first == "doc_filename";
+                reads_files |= call->first == "readfile";
+            }
+        }, cmd);
+    }
+}
+
+layout_digest bls::digest_layout(const fs::path &filename) {
+    util::sha256 hash;
+    layout_digest ret;
+    std::set<fs::path> visited;
+    digest_file(filename, hash, ret.reads_doc_filename, ret.reads_files, visited);
+    ret.program = hash.digest();
+    ret.files.assign(visited.begin(), visited.end());
+    return ret;
+}
+
+static constexpr std::string_view program_prefix = "### Program ";
+
+result_store::result_store(const fs::path &directory) : m_directory(directory) {
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (ec || !fs::is_directory(m_directory)) {
+        throw file_error(intl::translate("CANT_OPEN_FILE", m_directory.string()));
+    }
+}
+
+fs::path result_store::entry_path(const util::sha256_digest &key) const {
+    return m_directory / (util::to_hex(key) + ".json");
+}
+
+fs::path result_store::digest_path(const fs::path &filename) const {
+    return m_directory / (util::to_hex(util::sha256{}.update(fs::absolute(filename).string()).digest()) + ".layout");
+}
+
+// identifica la versione di un file senza leggerlo, ritorna una stringa vuota se non esiste
+static std::string file_stamp(const fs::path &filename) {
+    std::error_code ec;
+    auto time = fs::last_write_time(filename, ec);
+    if (ec) return {};
+    auto size = fs::file_size(filename, ec);
+    if (ec) return {};
+    return std::format("{} {}", time.time_since_epoch().count(), size);
+}
+
+// La voce contiene una riga con l'hash del programma e i flag, seguita da due righe per ogni file:
+// il percorso e la sua versione al momento della compilazione
+layout_digest result_store::digest(const fs::path &filename) const {
+    auto path = digest_path(filename);
+    if (std::ifstream input(path, std::ios::binary); input) {
+        layout_digest ret;
+        std::string program;
+        bool valid = bool(input >> program >> ret.reads_doc_filename >> ret.reads_files) && program.size() == 64;
+        input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        for (std::string file, stamp; valid && std::getline(input, file) && std::getline(input, stamp);) {
+            valid = stamp == file_stamp(file);
+            ret.files.emplace_back(file);
+        }
+        if (valid && !ret.files.empty()) {
+            for (size_t i = 0; i < ret.program.size(); ++i) {
+                ret.program[i] = uint8_t(std::stoi(program.substr(i * 2, 2), nullptr, 16));
+            }
+            return ret;
+        }
+    }
+
+    auto ret = digest_layout(filename);
+
+    std::string data = std::format("{} {:d} {:d}\n", util::to_hex(ret.program), ret.reads_doc_filename, ret.reads_files);
+    for (const auto &file : ret.files) {
+        data += std::format("{}\n{}\n", file.string(), file_stamp(file));
+    }
+    std::string_view parts[] = {data};
+    util::write_file_atomic(path, parts);
+    return ret;
+}
+
+std::optional<std::string> result_store::load(const util::sha256_digest &key, const util::sha256_digest &program) const {
+    auto path = entry_path(key);
+    std::ifstream input(path, std::ios::binary);
+    if (!input) return std::nullopt;
+
+    std::string line;
+    std::getline(input, line);
+    if (line != std::format("{}{}", program_prefix, util::to_hex(program))) {
+        // uno dei layout e' cambiato dopo il salvataggio
+        input.close();
+        std::error_code ec;
+        fs::remove(path, ec);
+        return std::nullopt;
+    }
+
+    std::ostringstream result;
+    result << input.rdbuf();
+    return std::move(result).str();
+}
+
+void result_store::store(const util::sha256_digest &key, const util::sha256_digest &program, std::string_view result) {
+    auto header = std::format("{}{}\n", program_prefix, util::to_hex(program));
+    std::string_view parts[] = {header, result};
+    util::write_file_atomic(entry_path(key), parts);
+}
@@ -0,0 +1,47 @@
+#ifndef __RESULT_STORE_H__
+#define __RESULT_STORE_H__
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils/sha256.h"
+
+namespace bls {
+
+    struct layout_digest {
+        util::sha256_digest program{};      // hash del codice compilato del layout e di tutti i layout importati
+        bool reads_doc_filename = false;    // il risultato dipende anche dal nome del pdf
+        bool reads_files = false;           // il layout chiama readfile, il risultato dipende da altri file
+        std::vector<std::filesystem::path> files;   // il layout e tutti i layout importati
+    };
+
+    // compila il layout e i layout importati, anche indirettamente
+    layout_digest digest_layout(const std::filesystem::path &filename);
+
+    // Risultati salvati su disco, condivisi tra i processi.
+    // La chiave e' lo SHA-256 del pdf, del layout e delle opzioni, la voce contiene anche l'hash del programma:
+    // se cambia uno dei layout importati la voce non e' piu' valida e viene cancellata
+    class result_store {
+    public:
+        explicit result_store(const std::filesystem::path &directory);
+
+        // come digest_layout, ma il risultato viene salvato insieme alla data di modifica e alla dimensione
+        // dei file: finche' non cambiano i layout non vengono ricompilati
+        layout_digest digest(const std::filesystem::path &filename) const;
+
+        std::optional<std::string> load(const util::sha256_digest &key, const util::sha256_digest &program) const;
+        void store(const util::sha256_digest &key, const util::sha256_digest &program, std::string_view result);
+
+    private:
+        std::filesystem::path entry_path(const util::sha256_digest &key) const;
+        std::filesystem::path digest_path(const std::filesystem::path &filename) const;
+
+    private:
+        std::filesystem::path m_directory;
+    };
+
+}
+
+#endif
@@ -0,0 +1,344 @@
+#include "type_inference.h"
+
+#include <map>
+#include <vector>
+#include <optional>
+#include <algorithm>
+
+using namespace bls;
+
+namespace {
+
+    // tipo dedotto: NONE se non ci sono ancora informazioni, ANY se il tipo non e' noto
+    struct inferred_type {
+        enum { NONE, KNOWN, ANY } kind = ANY;
+        variable_type type = variable_type::NULLVAR;
+
+        inferred_type() = default;
+        inferred_type(variable_type type) : kind(KNOWN), type(type) {}
+
+        static inferred_type none() {
+            inferred_type ret;
+            ret.kind = NONE;
+            return ret;
+        }
+
+        bool is(variable_type t) const {
+            return kind == KNOWN && type == t;
+        }
+
+        bool operator == (const inferred_type &other) const = default;
+
+        inferred_type join(const inferred_type &other) const {
+            if (kind == NONE) return other;
+            if (other.kind == NONE || *this == other) return *this;
+            return {};
+        }
+    };
+
+    using typed_operator = std::pair<std::string_view, command_args (*)()>;
+
+    constexpr typed_operator int_operators[] {
+        {"add", make_command<opcode::ADDINT>},
+        {"sub", make_command<opcode::SUBINT>},
+        {"mul", make_command<opcode::MULINT>},
+    };
+
+    template<opcode Cmd> command_args make_jump(command_node node) {
+        return make_command<Cmd>(node);
+    }
+
+    using typed_jump = std::pair<opcode, command_args (*)(command_node)>;
+
+    constexpr typed_jump int_jumps[] {
+        {opcode::JZEQ,  make_jump<opcode::JZEQINT>},
+        {opcode::JZNEQ, make_jump<opcode::JZNEQINT>},
+        {opcode::JZLT,  make_jump<opcode::JZLTINT>},
+        {opcode::JZGT,  make_jump<opcode::JZGTINT>},
+        {opcode::JZLEQ, make_jump<opcode::JZLEQINT>},
+        {opcode::JZGEQ, make_jump<opcode::JZGEQINT>},
+    };
+
+    constexpr std::string_view boolean_functions[] {
+        "eq", "neq", "lt", "gt", "leq", "geq", "not", "and", "or", "bool", "isnull", "isempty"
+    };
+
+    constexpr std::string_view integer_functions[] {
+        "int", "size"
+    };
+
+    class type_inference {
+    public:
+        type_inference(command_list &code) : m_code(code) {}
+
+        void operator()() {
+            // i tipi delle variabili locali possono solo allargarsi, si ripete finche' non cambiano
+            decltype(m_locals) prev_locals;
+            do {
+                prev_locals = m_locals;
+                analyze(false);
+            } while (prev_locals != m_locals);
+            analyze(true);
+        }
+
+    private:
+        void analyze(bool specialize);
+        void analyze_command(command_args &cmd, bool specialize);
+        inferred_type call_result(std::string_view name, const inferred_type &lhs, const inferred_type &rhs) const;
+
+        inferred_type pop() {
+            if (m_stack.empty()) return {};
+            auto ret = m_stack.back();
+            m_stack.pop_back();
+            return ret;
+        }
+
+        void push(inferred_type type) {
+            m_stack.push_back(type);
+        }
+
+        void store(inferred_type type);
+
+        inferred_type local_type(std::string_view name) const {
+            if (m_tainted) return {};
+            auto it = m_locals.find(name);
+            if (it == m_locals.end()) return inferred_type::none();
+            return it->second;
+        }
+
+    private:
+        command_list &m_code;
+
+        // tipi sullo stack nel blocco corrente, dal fondo alla cima
+        std::vector<inferred_type> m_stack;
+
+        // nome della variabile locale selezionata, nullopt se non e' una locale o ha un indice
+        std::vector<std::optional<std::string_view>> m_selected;
+
+        std::map<std::string_view, inferred_type> m_locals;
+
+        // vero se e' stata assegnata una variabile che non si riesce a tracciare
+        bool m_tainted = false;
+    };
+
+    void type_inference::analyze(bool specialize) {
+        m_stack.clear();
+        m_selected.clear();
+        for (auto &cmd : m_code) {
+            analyze_command(cmd, specialize);
+        }
+    }
+
+    void type_inference::store(inferred_type type) {
+        if (m_selected.empty()) {
+            m_tainted = true;
+            return;
+        }
+        if (auto name = m_selected.back()) {
+            auto [it, inserted] = m_locals.try_emplace(*name, type);
+            if (!inserted) it->second = it->second.join(type);
+        }
+        m_selected.pop_back();
+    }
+
+    inferred_type type_inference::call_result(std::string_view name, const inferred_type &lhs, const inferred_type &rhs) const {
+        if (std::ranges::find(boolean_functions, name) != std::end(boolean_functions)) {
+            return variable_type::BOOLEAN;
+        }
+        if (std::ranges::find(integer_functions, name) != std::end(integer_functions)) {
+            return variable_type::INTEGER;
+        }
+        if (std::ranges::find(int_operators, name, &typed_operator::first) != std::end(int_operators)) {
+            if (lhs.kind == inferred_type::NONE || rhs.kind == inferred_type::NONE) {
+                return inferred_type::none();
+            }
+            if (lhs == rhs && (lhs.is(variable_type::INTEGER) || lhs.is(variable_type::NUMBER))) {
+                return lhs;
+            }
+        }
+        return {};
+    }
+
+    void type_inference::analyze_command(command_args &cmd, bool specialize) {
+        switch (cmd.command()) {
+        case opcode::LABEL:
+        case opcode::JMP:
+        case opcode::RET:
+        case opcode::IMPORT:
+            // inizio o fine di un blocco, lo stack non e' piu' noto
+            m_stack.clear();
+            break;
+        case opcode::JSR:
+            m_stack.clear();
+            break;
+        case opcode::JSRVAL:
+            m_stack.clear();
+            push({});
+            break;
+        case opcode::SELVAR:
+        case opcode::SELGLOBAL:
+            m_selected.emplace_back();
+            break;
+        case opcode::SELLOCALDYN:
+            // il nome non e' noto, qualsiasi variabile locale puo' essere assegnata
+            m_tainted = true;
+            [[fallthrough]];
+        case opcode::SELVARDYN:
+        case opcode::SELGLOBALDYN:
+            pop();
+            m_selected.emplace_back();
+            break;
+        case opcode::SELLOCAL:
+            m_selected.emplace_back(*cmd.get_args<opcode::SELLOCAL>());
+            break;
+        case opcode::SELINDEXDYN:
+            pop();
+            [[fallthrough]];
+        case opcode::SELINDEX:
+        case opcode::SELAPPEND:
+            if (!m_selected.empty()) {
+                // la variabile locale diventa un array
+                if (auto &name = m_selected.back()) {
+                    m_locals[*name] = {};
+                    name.reset();
+                }
+            }
+            break;
+        case opcode::FWDVAR:
+        case opcode::SETVAR:
+        case opcode::FORCEVAR:
+        case opcode::INCVAR:
+        case opcode::DECVAR:
+            store(pop());
+            break;
+        case opcode::CLEAR:
+        case opcode::PUSHVAR:
+            if (!m_selected.empty()) m_selected.pop_back();
+            if (cmd.command() == opcode::PUSHVAR) push({});
+            break;
+        case opcode::SUBITEMDYN:
+            pop();
+            [[fallthrough]];
+        case opcode::SUBITEM:
+            pop();
+            push({});
+            break;
+        case opcode::PUSHVARNAMED:
+        case opcode::PUSHGLOBALNAMED:
+        case opcode::PUSHVIEW:
+            push({});
+            break;
+        case opcode::PUSHLOCALNAMED:
+            push(local_type(*cmd.get_args<opcode::PUSHLOCALNAMED>()));
+            break;
+        case opcode::PUSHNULL:      push(variable_type::NULLVAR); break;
+        case opcode::PUSHNUM:       push(variable_type::NUMBER); break;
+        case opcode::PUSHBOOL:      push(variable_type::BOOLEAN); break;
+        case opcode::PUSHINT:       push(variable_type::INTEGER); break;
+        case opcode::PUSHDOUBLE:    push(variable_type::FLOAT); break;
+        case opcode::PUSHSTR:
+        case opcode::PUSHREGEX:
+        case opcode::RDBOX:
+        case opcode::RDPAGE:
+            push(variable_type::STRING);
+            break;
+        case opcode::STKAPP:
+            pop();
+            pop();
+            push(variable_type::ARRAY);
+            break;
+        case opcode::STKPICK:
+            push({});
+            break;
+        case opcode::STKDROP: {
+            auto top = pop();
+            for (size_t i = 0; i < cmd.get_args<opcode::STKDROP>(); ++i) pop();
+            push(top);
+            break;
+        }
+        case opcode::STKSWP: {
+            auto a = pop();
+            auto b = pop();
+            push(a);
+            push(b);
+            break;
+        }
+        case opcode::CALL: {
+            const auto &call = cmd.get_args<opcode::CALL>();
+            inferred_type lhs, rhs;
+            if (call.numargs == 2) {
+                rhs = pop();
+                lhs = pop();
+            } else {
+                for (size_t i = 0; i < call.numargs; ++i) pop();
+            }
+            std::string_view name = call->first;
+            auto result = call_result(name, lhs, rhs);
+            if (specialize && result.is(variable_type::INTEGER)) {
+                if (auto it = std::ranges::find(int_operators, name, &typed_operator::first); it != std::end(int_operators)) {
+                    cmd = it->second();
+                }
+            }
+            push(result);
+            break;
+        }
+        case opcode::SYSCALL:
+            for (size_t i = 0; i < cmd.get_args<opcode::SYSCALL>().numargs; ++i) pop();
+            break;
+        case opcode::ADDINT:
+        case opcode::SUBINT:
+        case opcode::MULINT: {
+            auto rhs = pop();
+            auto lhs = pop();
+            push(call_result("add", lhs, rhs));
+            break;
+        }
+        case opcode::MVBOX:
+        case opcode::MVNBOX:
+        case opcode::VIEWPOP:
+        case opcode::JZ:
+        case opcode::JNZ:
+        case opcode::MOVERVAL:
+        case opcode::COPYRVAL:
+            pop();
+            break;
+        case opcode::JZEQ:
+        case opcode::JZNEQ:
+        case opcode::JZLT:
+        case opcode::JZGT:
+        case opcode::JZLEQ:
+        case opcode::JZGEQ: {
+            auto rhs = pop();
+            auto lhs = pop();
+            if (specialize && lhs.is(variable_type::INTEGER) && rhs.is(variable_type::INTEGER)) {
+                visit_command(util::overloaded{
+                    []<opcode Cmd>(command_tag<Cmd>) {},
+                    []<opcode Cmd>(command_tag<Cmd>, auto &) {},
+                    [&]<opcode Cmd>(command_tag<Cmd>, command_node &node) {
+                        if (auto it = std::ranges::find(int_jumps, Cmd, &typed_jump::first); it != std::end(int_jumps)) {
+                            cmd = it->second(node);
+                        }
+                    }
+                }, cmd);
+            }
+            break;
+        }
+        case opcode::JZEQINT:
+        case opcode::JZNEQINT:
+        case opcode::JZLTINT:
+        case opcode::JZGTINT:
+        case opcode::JZLEQINT:
+        case opcode::JZGEQINT:
+            pop();
+            pop();
+            break;
+        default:
+            break;
+        }
+    }
+
+}
+
+void bls::specialize_typed_ops(command_list &code) {
+    type_inference{code}();
+}
\ No newline at end of file
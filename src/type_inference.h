@@ -0,0 +1,15 @@
+#ifndef __TYPE_INFERENCE_H__
+#define __TYPE_INFERENCE_H__
+
+#include "bytecode.h"
+
+namespace bls {
+
+    // Deduce i tipi dei valori sullo stack e delle variabili locali,
+    // sostituendo gli operatori aritmetici e i confronti tra interi con le versioni specializzate.
+    // Va eseguito prima di rimuovere le label, che delimitano i blocchi.
+    void specialize_typed_ops(command_list &code);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,209 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <memory_resource>
+#include <memory>
+#include <string>
+#include <utility>
+#include <new>
+#include <algorithm>
+
+namespace util {
+
+    namespace detail {
+        inline thread_local std::pmr::memory_resource *s_current_resource = nullptr;
+    }
+
+    // risorsa usata per le allocazioni degli oggetti creati nel thread corrente
+    inline std::pmr::memory_resource *current_resource() noexcept {
+        if (auto *res = detail::s_current_resource) {
+            return res;
+        }
+        return std::pmr::get_default_resource();
+    }
+
+    // imposta la risorsa corrente fino alla fine dello scope
+    class resource_scope {
+    private:
+        std::pmr::memory_resource *m_prev;
+
+    public:
+        explicit resource_scope(std::pmr::memory_resource *res) noexcept
+            : m_prev(std::exchange(detail::s_current_resource, res)) {}
+
+        ~resource_scope() {
+            detail::s_current_resource = m_prev;
+        }
+
+        resource_scope(const resource_scope &) = delete;
+        resource_scope &operator = (const resource_scope &) = delete;
+    };
+
+    // lanciata da counting_resource quando un'allocazione supera il limite
+    struct quota_exceeded : std::bad_alloc {
+        const char *what() const noexcept override {
+            return "memory quota exceeded";
+        }
+    };
+
+    // inoltra le allocazioni alla risorsa sottostante contandole
+    class counting_resource : public std::pmr::memory_resource {
+    private:
+        std::pmr::memory_resource *m_upstream;
+
+        size_t m_allocations = 0;
+        size_t m_bytes = 0;
+
+        // byte allocati e non ancora liberati
+        size_t m_live_bytes = 0;
+        size_t m_peak_bytes = 0;
+
+        size_t m_limit = 0;
+
+    public:
+        explicit counting_resource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+            : m_upstream(upstream) {}
+
+        size_t allocations() const noexcept { return m_allocations; }
+        size_t bytes() const noexcept { return m_bytes; }
+        size_t live_bytes() const noexcept { return m_live_bytes; }
+        size_t peak_bytes() const noexcept { return m_peak_bytes; }
+
+        // le allocazioni che porterebbero i byte in uso oltre limit lanciano quota_exceeded, 0 = nessun limite
+        void set_limit(size_t limit) noexcept {
+            m_limit = limit;
+        }
+
+        // da chiamare quando la risorsa sottostante e' stata svuotata
+        void reset_counters() noexcept {
+            m_allocations = 0;
+            m_bytes = 0;
+            m_live_bytes = 0;
+            m_peak_bytes = 0;
+        }
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            if (m_limit && m_live_bytes + bytes > m_limit) {
+                throw quota_exceeded{};
+            }
+            void *ptr = m_upstream->allocate(bytes, alignment);
+            ++m_allocations;
+            m_bytes += bytes;
+            m_live_bytes += bytes;
+            m_peak_bytes = std::max(m_peak_bytes, m_live_bytes);
+            return ptr;
+        }
+
+        void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+            // gli oggetti sopravvissuti al reset non vanno sottratti due volte
+            m_live_bytes -= std::min(m_live_bytes, bytes);
+            m_upstream->deallocate(ptr, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    // Allocatore che prende la risorsa corrente al momento della costruzione.
+    // A differenza di polymorphic_allocator segue il contenitore negli spostamenti,
+    // e le copie usano la risorsa corrente e non quella dell'originale.
+    template<typename T> class arena_allocator {
+    private:
+        std::pmr::memory_resource *m_resource;
+
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        arena_allocator() noexcept : m_resource(current_resource()) {}
+        arena_allocator(std::pmr::memory_resource *res) noexcept : m_resource(res) {}
+
+        template<typename U>
+        arena_allocator(const arena_allocator<U> &other) noexcept : m_resource(other.resource()) {}
+
+        T *allocate(size_t n) {
+            return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *ptr, size_t n) {
+            m_resource->deallocate(ptr, n * sizeof(T), alignof(T));
+        }
+
+        arena_allocator select_on_container_copy_construction() const {
+            return {};
+        }
+
+        std::pmr::memory_resource *resource() const noexcept {
+            return m_resource;
+        }
+
+        template<typename U>
+        bool operator == (const arena_allocator<U> &other) const noexcept {
+            return m_resource == other.resource() || m_resource->is_equal(*other.resource());
+        }
+    };
+
+    using arena_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
+    template<typename T> struct arena_deleter {
+        std::pmr::memory_resource *resource;
+
+        void operator()(T *ptr) const {
+            std::destroy_at(ptr);
+            resource->deallocate(ptr, sizeof(T), alignof(T));
+        }
+    };
+
+    template<typename T> using arena_ptr = std::unique_ptr<T, arena_deleter<T>>;
+
+    // Oggetto allocato nella risorsa corrente che ricorda da quale risorsa proviene,
+    // per possederlo basta un puntatore invece di un arena_ptr
+    template<typename T> class arena_box {
+    private:
+        std::pmr::memory_resource *m_resource;
+
+    public:
+        T value;
+
+        template<typename ... Ts>
+        arena_box(std::pmr::memory_resource *res, Ts && ... args)
+            : m_resource(res), value(std::forward<Ts>(args) ...) {}
+
+        template<typename ... Ts>
+        static arena_box *create(Ts && ... args) {
+            auto *res = current_resource();
+            void *mem = res->allocate(sizeof(arena_box), alignof(arena_box));
+            try {
+                return std::construct_at(static_cast<arena_box *>(mem), res, std::forward<Ts>(args) ...);
+            } catch (...) {
+                res->deallocate(mem, sizeof(arena_box), alignof(arena_box));
+                throw;
+            }
+        }
+
+        static void destroy(arena_box *box) {
+            auto *res = box->m_resource;
+            std::destroy_at(box);
+            res->deallocate(box, sizeof(arena_box), alignof(arena_box));
+        }
+    };
+
+    // come make_unique, ma alloca l'oggetto nella risorsa corrente
+    template<typename T, typename ... Ts>
+    arena_ptr<T> make_arena(Ts && ... args) {
+        auto *res = current_resource();
+        void *mem = res->allocate(sizeof(T), alignof(T));
+        try {
+            return arena_ptr<T>(std::construct_at(static_cast<T *>(mem), std::forward<Ts>(args) ...), {res});
+        } catch (...) {
+            res->deallocate(mem, sizeof(T), alignof(T));
+            throw;
+        }
+    }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef __ATOMIC_FILE_H__
+#define __ATOMIC_FILE_H__
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <atomic>
+#include <span>
+#include <string_view>
+
+#include "format.h"
+
+namespace util {
+
+    // Scrive le parti su un file temporaneo e lo rinomina, la rinomina e' atomica:
+    // gli altri processi vedono il file intero o non lo vedono.
+    // Ritorna false se la scrittura non e' riuscita
+    inline bool write_file_atomic(const std::filesystem::path &filename, std::span<const std::string_view> parts) {
+        // il nome temporaneo non deve coincidere con quello di un altro processo che scrive lo stesso file
+        static const uint64_t process_id = (uint64_t(std::random_device{}()) << 32) | std::random_device{}();
+        static std::atomic<uint64_t> counter = 0;
+        auto temp_path = filename;
+        temp_path += std::format(".{:x}.{:x}.tmp", process_id, counter++);
+
+        std::error_code ec;
+        {
+            std::ofstream output(temp_path, std::ios::binary);
+            if (!output) return false;
+            for (auto part : parts) {
+                output.write(part.data(), part.size());
+            }
+            if (!output) {
+                output.close();
+                std::filesystem::remove(temp_path, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temp_path, filename, ec);
+        if (ec) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+}
+
+#endif
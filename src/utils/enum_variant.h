@@ -48,6 +48,10 @@ namespace enums {
         template<Enum Value> auto &get() {
             return std::get<indexof(Value)>(*this);
         }
+
+        template<Enum Value> const auto *get_if() const {
+            return std::get_if<indexof(Value)>(this);
+        }
     };
     
     namespace detail {
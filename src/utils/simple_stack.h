@@ -1,7 +1,7 @@
 #ifndef __SIMPLE_STACK_H__
 #define __SIMPLE_STACK_H__
 
-#include <deque>
+#include <vector>
 
 namespace util {
     template<typename Container> class back_popper {
@@ -19,7 +19,7 @@ namespace util {
         const auto *operator ->() const { return &m_container->back(); }
     };
 
-    template<typename T, typename Container = std::deque<T>> struct simple_stack : public Container {
+    template<typename T, typename Container = std::vector<T>> struct simple_stack : public Container {
         using base = Container;
         
         constexpr T &top() { return base::back(); }
@@ -9,6 +9,8 @@ namespace unicode {
 
     std::string escapeString(std::string_view str);
 
+    std::string codePointToUTF8(unsigned int cp);
+
 }
 
 #endif
\ No newline at end of file
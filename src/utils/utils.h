@@ -90,13 +90,11 @@ namespace util {
     }
 
     // elimina gli spazi in eccesso a inizio e fine stringa
-    inline std::string string_trim(std::string_view str) {
-        return str
-            | std::views::drop_while(isspace)
-            | std::views::reverse
-            | std::views::drop_while(isspace)
-            | std::views::reverse
-            | util::range_to<std::string>;
+    inline std::string_view string_trim(std::string_view str) {
+        auto begin = std::ranges::find_if_not(str, isspace);
+        auto end = std::ranges::find_if_not(str | std::views::reverse, isspace).base();
+        if (begin >= end) return str.substr(str.size());
+        return std::string_view(begin, end);
     }
 
     // sostituisce tutte le occorrenze di una stringa in un'altra
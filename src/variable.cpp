@@ -37,41 +37,54 @@ struct string_converter {
         return date.to_string();
     }
     std::string operator()(const variable_array &arr) const {
-        return std::format("[{}]", util::string_join(arr | std::views::transform(&variable::as_view), ", "));
+        return std::format("[{}]", util::string_join(arr | std::views::transform(&variable::as_string), ", "));
     }
 };
 
-const std::string &variable::as_string() const & {
-    const auto &var = deref();
-    if (!var.m_str) {
-        var.m_str = std::make_unique<std::string>(enums::visit(string_converter{}, var.m_value));
-    }
-    return *var.m_str;
+std::string variable::as_string() const {
+    return deref().visit(string_converter{});
 }
 
-std::string variable::as_string() && {
-    if (auto *ptr = std::get_if<variable_ptr>(&m_value)) {
-        return (*ptr)->as_string();
-    } else if (m_str) {
-        return std::move(*m_str);
-    } else {
-        return enums::visit(string_converter{}, m_value);
+static void check_array_type(variable_type type) {
+    if (type != variable_type::ARRAY) {
+        throw conversion_error(intl::translate("CANT_CONVERT_TYPE_TO_TYPE", intl::enum_label(type), intl::enum_label(variable_type::ARRAY)));
     }
 }
 
+// l'array puo' essere modificato dal chiamante, se e' condiviso viene duplicato
 variable_array &variable::as_array() {
-    return std::get<variable_array>(m_value);
+    check_array_type(m_type);
+    unshare_array();
+    return m_array->value.values;
 }
 
 const variable_array &variable::as_array() const {
-    return std::get<variable_array>(deref().m_value);
+    const auto &var = deref();
+    check_array_type(var.m_type);
+    return var.m_array->value.values;
 }
 
 string_state variable::as_view() const {
-    if (auto *view = std::get_if<string_state>(&deref().m_value)) {
-        return *view;
-    } else {
-        return std::string_view(as_string());
+    const auto &var = deref();
+    switch (var.m_type) {
+    case variable_type::NULLVAR:
+        return {};
+    case variable_type::STRING:
+        return var.get<variable_type::STRING>();
+    default:
+        throw conversion_error(intl::translate("CANT_CONVERT_TYPE_TO_TYPE", intl::enum_label(var.m_type), intl::enum_label(variable_type::STRING)));
+    }
+}
+
+string_state variable::as_view(string_storage &storage) const {
+    const auto &var = deref();
+    switch (var.m_type) {
+    case variable_type::NULLVAR:
+        return {};
+    case variable_type::STRING:
+        return var.get<variable_type::STRING>();
+    default:
+        return std::string_view(storage.emplace_back(var.visit(string_converter{})));
     }
 }
 
@@ -109,40 +122,32 @@ template<std::floating_point T> struct number_converter<T> : number_converter_ba
 template<typename T> concept number_t = std::invocable<number_converter<T>, string_state>;
 
 fixed_point variable::as_number() const {
-    return enums::visit(number_converter<fixed_point>{}, deref().m_value);
+    return deref().visit(number_converter<fixed_point>{});
 }
 
 int64_t variable::as_int() const {
-    return enums::visit(number_converter<int64_t>{}, deref().m_value);
+    return deref().visit(number_converter<int64_t>{});
 }
 
 double variable::as_double() const {
-    return enums::visit(number_converter<double>{}, deref().m_value);
+    return deref().visit(number_converter<double>{});
 }
 
 datetime variable::as_date() const {
-    return enums::visit(basic_converter<datetime>{}, deref().m_value);
+    return deref().visit(basic_converter<datetime>{});
 }
 
 variable_ptr variable::as_pointer() const {
-    if (auto *ptr = std::get_if<variable_ptr>(&m_value)) {
-        return (*ptr)->as_pointer();
+    if (m_type == variable_type::POINTER) {
+        return m_ptr->as_pointer();
     } else {
         return this;
     }
 }
 
-const variable &variable::deref() const & {
-    if (auto *ptr = std::get_if<variable_ptr>(&m_value)) {
-        return (*ptr)->deref();
-    } else {
-        return *this;
-    }
-}
-
 variable variable::deref() && {
-    if (auto *ptr = std::get_if<variable_ptr>(&m_value)) {
-        return (*ptr)->deref();
+    if (m_type == variable_type::POINTER) {
+        return m_ptr->deref();
     } else {
         return std::move(*this);
     }
@@ -156,37 +161,37 @@ struct size_getter {
 };
 
 size_t variable::size() const {
-    return enums::visit(size_getter{}, deref().m_value);
+    return deref().visit(size_getter{});
 }
 
 bool variable::is_empty() const {
-    return enums::visit(std::not_fn(size_getter{}), deref().m_value);
+    return deref().visit(std::not_fn(size_getter{}));
 }
 
 bool variable::is_true() const {
-    return enums::visit(util::overloaded{
+    return deref().visit(util::overloaded{
         [](const auto &value) { return size_getter{}(value) != 0; },
         [](const number_t auto &num) { return num != 0; }
-    }, deref().m_value);
+    });
 }
 
 bool variable::is_null() const {
-    return std::holds_alternative<std::monostate>(m_value);
+    return m_type == variable_type::NULLVAR;
 }
 
 bool variable::is_pointer() const {
-    return std::holds_alternative<variable_ptr>(m_value);
+    return m_type == variable_type::POINTER;
 }
 
 bool variable::is_number() const {
-    return enums::visit(util::overloaded{
-        [](number_t auto)   { return true; },
-        [](auto)            { return false; }
-    }, deref().m_value);
+    return deref().visit(util::overloaded{
+        [](const number_t auto &) { return true; },
+        [](const auto &)          { return false; }
+    });
 }
 
 bool variable::is_array() const {
-    return std::holds_alternative<variable_array>(deref().m_value);
+    return deref().m_type == variable_type::ARRAY;
 }
 
 template<typename T> concept not_monostate = ! std::same_as<T, std::monostate>;
@@ -241,41 +246,261 @@ struct variable_comparator {
     }
 };
 
-std::partial_ordering variable::operator <=> (const variable &other) const {
-    return enums::visit(variable_comparator{}, deref().m_value, other.deref().m_value);
+std::partial_ordering variable::compare(const variable &lhs, const variable &rhs) {
+    return visit(variable_comparator{}, lhs, rhs);
 }
 
-variable &variable::operator = (const variable &other) {
-    if (auto *view = std::get_if<string_state>(&other.m_value); view && other.m_str) {
-        m_str = std::make_unique<std::string>(*view);
-        m_value = string_state(*m_str, view->flags);
+variable::string_buffer *variable::string_buffer::create(std::string_view str, size_t capacity) {
+    auto *res = util::current_resource();
+    void *mem = res->allocate(sizeof(string_buffer) + capacity, alignof(string_buffer));
+    auto *buf = std::construct_at(static_cast<string_buffer *>(mem), res, capacity);
+    std::ranges::copy(str, buf->data());
+    return buf;
+}
+
+void variable::string_buffer::destroy(string_buffer *buf) {
+    buf->resource->deallocate(buf, sizeof(string_buffer) + buf->capacity, alignof(string_buffer));
+}
+
+void variable::set_string(std::string_view str, string_flags flags) {
+    uint32_t size = checked_size(str.size());
+    m_type = variable_type::STRING;
+    m_size = size;
+    m_buffer = string_buffer::create(str, str.size());
+    m_flags = (flags.is_regex ? flag_regex : 0) | flag_owned;
+}
+
+void variable::append_string(std::string_view str) {
+    // str puo' puntare alla stringa stessa, viene copiata prima di liberare il buffer.
+    // Se il buffer e' condiviso con altre variabili si crea un nuovo buffer
+    size_t new_size = checked_size(m_size + str.size());
+    if ((m_flags & flag_owned) && m_buffer->refs == 1 && new_size <= m_buffer->capacity) {
+        std::ranges::copy(str, m_buffer->data() + m_size);
     } else {
-        m_str.reset();
-        m_value = other.m_value;
+        auto *buf = string_buffer::create(std::string_view(string_data(), m_size), std::max(new_size, size_t(m_size) * 2));
+        std::ranges::copy(str, buf->data() + m_size);
+        release_string();
+        m_buffer = buf;
+        m_flags = (m_flags & flag_regex) | flag_owned;
+    }
+    m_size = uint32_t(new_size);
+}
+
+// str deve essere contenuta nel buffer
+void variable::set_slice(string_buffer *buffer, std::string_view str) {
+    uint32_t size = checked_size(str.size());
+    m_slice = slice_box::create(buffer, size_t(str.data() - buffer->data()));
+    ++buffer->refs;
+    m_type = variable_type::STRING;
+    m_size = size;
+    m_flags = (m_flags & flag_regex) | flag_slice;
+}
+
+void variable::release_string() noexcept {
+    if (m_flags & flag_owned) {
+        if (--m_buffer->refs == 0) {
+            string_buffer::destroy(m_buffer);
+        }
+    } else if (m_flags & flag_slice) {
+        if (--m_slice->value.refs == 0) {
+            auto *buf = m_slice->value.buffer;
+            if (--buf->refs == 0) {
+                string_buffer::destroy(buf);
+            }
+            slice_box::destroy(m_slice);
+        }
+    }
+}
+
+static bool contains_view(std::string_view outer, std::string_view inner) {
+    return std::less_equal<const char *>{}(outer.data(), inner.data())
+        && std::less_equal<const char *>{}(inner.data() + inner.size(), outer.data() + outer.size());
+}
+
+void variable::detach_from(const variable &source) {
+    if (m_type == variable_type::ARRAY) {
+        // un array condiviso ha gli elementi di un'altra variabile, che non dipendono da source
+        if (m_array->value.refs == 1) {
+            for (auto &value : m_array->value.values) {
+                value.detach_from(source);
+            }
+        }
+        return;
+    }
+    if (m_type != variable_type::STRING || (m_flags & (flag_owned | flag_slice))) {
+        return;
+    }
+
+    std::string_view str(m_chars, m_size);
+    const auto &src = source.deref();
+    if (src.m_flags & (flag_owned | flag_slice)) {
+        std::string_view src_str(src.string_data(), src.m_size);
+        if (contains_view(src_str, str)) {
+            set_slice(src.m_flags & flag_owned ? src.m_buffer : src.m_slice->value.buffer, str);
+        }
+    }
+}
+
+void variable::detach_from_text(std::string_view text) {
+    if (m_type == variable_type::ARRAY) {
+        if (m_array->value.refs == 1) {
+            for (auto &value : m_array->value.values) {
+                value.detach_from_text(text);
+            }
+        }
+        return;
+    }
+    if (m_type != variable_type::STRING || (m_flags & (flag_owned | flag_slice))) {
+        return;
+    }
+
+    std::string_view str(m_chars, m_size);
+    if (contains_view(text, str)) {
+        set_string(str, string_flags{bool(m_flags & flag_regex)});
+    }
+}
+
+void variable::unshare_array() {
+    if (m_array->value.refs > 1) {
+        auto *box = array_box::create(m_array->value.values);
+        --m_array->value.refs;
+        m_array = box;
+    }
+}
+
+void variable::copy_from(const variable &other) {
+    switch (other.m_type) {
+    case variable_type::NULLVAR:
+        break;
+    case variable_type::STRING:
+        if (other.m_flags & flag_owned) {
+            m_buffer = other.m_buffer;
+            ++m_buffer->refs;
+        } else if (other.m_flags & flag_slice) {
+            m_slice = other.m_slice;
+            ++m_slice->value.refs;
+        } else {
+            m_chars = other.m_chars;
+        }
+        m_size = other.m_size;
+        m_flags = other.m_flags;
+        break;
+    case variable_type::NUMBER:
+        std::construct_at(&m_number, other.scalar<variable_type::NUMBER>());
+        break;
+    case variable_type::BOOLEAN:
+        m_bool = other.scalar<variable_type::BOOLEAN>();
+        break;
+    case variable_type::INTEGER:
+        m_int = other.scalar<variable_type::INTEGER>();
+        break;
+    case variable_type::FLOAT:
+        m_double = other.scalar<variable_type::FLOAT>();
+        break;
+    case variable_type::DATETIME:
+        std::construct_at(&m_date, other.scalar<variable_type::DATETIME>());
+        break;
+    case variable_type::ARRAY:
+        m_array = other.m_array;
+        ++m_array->value.refs;
+        break;
+    case variable_type::POINTER:
+        m_ptr = other.m_ptr;
+        break;
+    }
+    m_type = other.m_type;
+}
+
+void variable::move_from(variable &other) noexcept {
+    if (other.m_flags & flag_owned) {
+        m_buffer = other.m_buffer;
+    } else if (other.m_flags & flag_slice) {
+        m_slice = other.m_slice;
+    } else switch (other.m_type) {
+    case variable_type::NULLVAR:
+        break;
+    case variable_type::STRING:
+        m_chars = other.m_chars;
+        break;
+    case variable_type::NUMBER:
+        std::construct_at(&m_number, other.m_number);
+        break;
+    case variable_type::BOOLEAN:
+        m_bool = other.m_bool;
+        break;
+    case variable_type::INTEGER:
+        m_int = other.m_int;
+        break;
+    case variable_type::FLOAT:
+        m_double = other.m_double;
+        break;
+    case variable_type::DATETIME:
+        std::construct_at(&m_date, other.m_date);
+        break;
+    case variable_type::ARRAY:
+        m_array = other.m_array;
+        break;
+    case variable_type::POINTER:
+        m_ptr = other.m_ptr;
+        break;
+    }
+    m_size = other.m_size;
+    m_type = other.m_type;
+    m_flags = other.m_flags;
+
+    other.m_int = 0;
+    other.m_size = 0;
+    other.m_type = variable_type::NULLVAR;
+    other.m_flags = 0;
+}
+
+void variable::destroy() noexcept {
+    if (m_flags & (flag_owned | flag_slice)) {
+        release_string();
+    } else if (m_type == variable_type::ARRAY) {
+        if (--m_array->value.refs == 0) {
+            array_box::destroy(m_array);
+        }
+    }
+}
+
+// other puo' essere contenuta in questa variabile, viene copiata prima di distruggere il valore
+variable &variable::operator = (const variable &other) {
+    if (this != &other) {
+        variable copy(other);
+        destroy();
+        move_from(copy);
     }
     return *this;
 }
 
+variable &variable::operator = (variable &&other) noexcept {
+    if (this != &other) {
+        variable tmp(std::move(other));
+        destroy();
+        move_from(tmp);
+    }
+    return *this;
+}
+
+// le stringhe che non appartengono alla variabile vengono copiate
 void variable::assign(const variable &other) {
     const auto &var = other.deref();
-    if (auto *view = std::get_if<string_state>(&var.m_value)) {
-        m_str = std::make_unique<std::string>(*view);
-        m_value = string_state(*m_str, view->flags);
+    if (var.m_type == variable_type::STRING && !(var.m_flags & (flag_owned | flag_slice))) {
+        auto str = var.get<variable_type::STRING>();
+        variable copy;
+        copy.set_string(str, str.flags);
+        *this = std::move(copy);
     } else {
         *this = var;
     }
 }
 
 void variable::assign(variable &&other) {
-    if (auto *ptr = std::get_if<variable_ptr>(&other.m_value)) {
-        assign((*ptr)->deref());
-    } else if (auto *view = std::get_if<string_state>(&other.m_value)) {
-        if (other.m_str) {
-            m_str = std::move(other.m_str);
-        } else {
-            m_str = std::make_unique<std::string>(*view);
-        }
-        m_value = string_state(*m_str, view->flags);
+    if (other.m_type == variable_type::POINTER) {
+        assign(other.m_ptr->deref());
+    } else if (other.m_type == variable_type::STRING && !(other.m_flags & (flag_owned | flag_slice))) {
+        assign(std::as_const(other));
     } else {
         *this = std::move(other);
     }
@@ -302,29 +527,22 @@ struct operator_caller {
 template<typename T> constexpr bool is_string_state = std::is_same_v<std::decay_t<T>, string_state>;
 
 variable &variable::operator += (const variable &other) {
-    enums::visit(util::overloaded{
+    visit(util::overloaded{
         [this](const auto &lhs, const auto &rhs) {
-            string_flags flags = as_string_tag;
-            if constexpr (is_string_state<decltype(lhs)>) {
-                if (!m_str) {
-                    m_str = std::make_unique<std::string>(lhs);
-                }
-                flags = lhs.flags;
-            } else if (!m_str) {
-                m_str = std::make_unique<std::string>(string_converter{}(lhs));
+            if constexpr (!is_string_state<decltype(lhs)>) {
+                *this = variable(string_converter{}(lhs));
             }
             if constexpr (is_string_state<decltype(rhs)>) {
-                m_str->append(rhs);
+                append_string(rhs);
             } else {
-                m_str->append(string_converter{}(rhs));
+                append_string(string_converter{}(rhs));
             }
-            m_value = string_state(*m_str, flags);
         },
         [this](const number_t auto &num1, const number_t auto &num2) {
             *this = operator_caller<std::plus<>>{}(num1, num2);
         },
-        [this](variable_array &arr, const variable_array &rhs) {
-            m_str.reset();
+        [this](const variable_array &, const variable_array &rhs) {
+            auto &arr = as_array();
             arr.insert(arr.end(), rhs.begin(), rhs.end());
         },
         [this](std::monostate, const not_monostate auto &value) {
@@ -333,32 +551,47 @@ variable &variable::operator += (const variable &other) {
         [this](variable_ptr lhs, const not_monostate auto &rhs) {
             assign(*lhs + rhs);
         },
-        [](auto, std::monostate) {},
-    }, m_value, other.deref().m_value);
+        [](const auto &, std::monostate) {},
+    }, *this, other.deref());
     return *this;
 }
 
 variable variable::operator +(const variable &rhs) const {
+    const auto &lhs_var = deref();
+    const auto &rhs_var = rhs.deref();
+    // tra due stringhe il risultato viene scritto in un solo buffer della misura giusta,
+    // invece di condividere il buffer di sinistra e riallocarlo subito dopo
+    if (lhs_var.m_type == variable_type::STRING && rhs_var.m_type == variable_type::STRING) {
+        std::string_view lhs_str(lhs_var.string_data(), lhs_var.m_size);
+        std::string_view rhs_str(rhs_var.string_data(), rhs_var.m_size);
+        variable ret;
+        ret.m_size = checked_size(lhs_str.size() + rhs_str.size());
+        ret.m_buffer = string_buffer::create(lhs_str, ret.m_size);
+        std::ranges::copy(rhs_str, ret.m_buffer->data() + lhs_str.size());
+        ret.m_type = variable_type::STRING;
+        ret.m_flags = (lhs_var.m_flags & flag_regex) | flag_owned;
+        return ret;
+    }
     variable copy = *this;
     return copy += rhs;
 }
 
 variable variable::operator -() const {
-    return enums::visit<variable>(util::overloaded{
+    return deref().visit<variable>(util::overloaded{
         [](std::monostate) {
             return variable();
         },
-        [](number_t auto n) {
+        [](const number_t auto &n) {
             return -n;
         },
-        [](auto v) {
+        [](const auto &v) {
             return -number_converter<fixed_point>{}(v);
         }
-    }, deref().m_value);
+    });
 }
 
 variable variable::operator -(const variable &other) const {
-    return enums::visit<variable>(operator_caller<std::minus<>>{}, deref().m_value, other.deref().m_value);
+    return visit<variable>(operator_caller<std::minus<>>{}, deref(), other.deref());
 }
 
 variable &variable::operator -= (const variable &other) {
@@ -366,9 +599,9 @@ variable &variable::operator -= (const variable &other) {
 }
 
 variable variable::operator * (const variable &other) const {
-    return enums::visit<variable>(operator_caller<std::multiplies<>>{}, deref().m_value, other.deref().m_value);
+    return visit<variable>(operator_caller<std::multiplies<>>{}, deref(), other.deref());
 }
 
 variable variable::operator / (const variable &other) const {
-    return enums::visit<variable>(operator_caller<std::divides<>>{}, deref().m_value, other.deref().m_value);
+    return visit<variable>(operator_caller<std::divides<>>{}, deref(), other.deref());
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <limits>
+#include <deque>
+
+#include "utils/arena.h"
 
 #include "fixed_point.h"
 #include "datetime.h"
@@ -23,13 +27,18 @@ namespace bls {
 
         string_state(std::string_view str, string_flags flags = as_string_tag)
             : std::string_view(str), flags(flags) {}
-        
+
         string_flags flags;
     };
 
     class variable;
 
-    using variable_array = std::vector<variable>;
+    // testo dei valori convertiti in stringa: std::deque non sposta gli elementi,
+    // le viste ritornate da as_view restano valide finche' esiste
+    using string_storage = std::deque<std::string>;
+
+    using variable_array = std::vector<variable, util::arena_allocator<variable>>;
+    using variable_string = util::arena_string;
     using variable_ptr = const variable *;
 
     DEFINE_ENUM_TYPES(variable_type,
@@ -46,56 +55,66 @@ namespace bls {
 
     using variable_variant = enums::enum_variant<variable_type>;
 
+    // Occupa 16 byte: 8 per il valore, poi la lunghezza della stringa, il tipo e i flag.
+    // Le stringhe possedute e gli array sono in un blocco allocato nell'arena,
+    // che non si sposta insieme alla variabile.
+    // I blocchi sono condivisi tra le copie e vengono duplicati solo prima di essere modificati.
+    // Le sottostringhe di una stringa posseduta condividono il suo buffer senza copiarlo.
     class variable {
     public:
-        variable() = default;
+        variable() noexcept : m_int(0) {}
 
-        variable(const variable &var) {
-            *this = var;
+        variable(const variable &other) {
+            copy_from(other);
         }
-        variable(variable &&var) = default;
 
-        ~variable() = default;
+        variable(variable &&other) noexcept {
+            move_from(other);
+        }
 
-        variable &operator = (const variable &other);
-        variable &operator = (variable &&other) = default;
+        ~variable() {
+            destroy();
+        }
 
-        variable(const std::string &value, string_flags state = as_string_tag)
-            : m_str(std::make_unique<std::string>(value))
-            , m_value(string_state(*m_str, state)) {}
+        variable &operator = (const variable &other);
+        variable &operator = (variable &&other) noexcept;
 
-        variable(std::string &&value, string_flags state = as_string_tag)
-            : m_str(std::make_unique<std::string>(std::move(value)))
-            , m_value(string_state(*m_str, state)) {}
+        variable(const std::string &value, string_flags flags = as_string_tag) {
+            set_string(value, flags);
+        }
 
-        variable(std::string_view value, string_flags state = as_string_tag)
-            : m_value(string_state(value, state)) {}
+        // non copia la stringa, che deve sopravvivere alla variabile
+        variable(std::string_view value, string_flags flags = as_string_tag)
+            : m_chars(value.data())
+            , m_size(checked_size(value.size()))
+            , m_type(variable_type::STRING)
+            , m_flags(flags.is_regex ? flag_regex : 0) {}
 
-        variable(fixed_point value) : m_value(value) {}
-        variable(std::integral auto value) : m_value(int64_t(value)) {}
-        variable(std::floating_point auto value) : m_value(double(value)) {}
-        variable(bool value) : m_value(value) {}
+        variable(fixed_point value) : m_number(value), m_type(variable_type::NUMBER) {}
+        variable(std::integral auto value) : m_int(value), m_type(variable_type::INTEGER) {}
+        variable(std::floating_point auto value) : m_double(value), m_type(variable_type::FLOAT) {}
+        variable(bool value) : m_bool(value), m_type(variable_type::BOOLEAN) {}
 
-        variable(datetime value) : m_value(value) {}
+        variable(datetime value) : m_date(value), m_type(variable_type::DATETIME) {}
 
-        variable(const variable_array &vec) : m_value(vec) {}
-        variable(variable_array &&vec) : m_value(std::move(vec)) {}
+        variable(const variable_array &vec) : variable(variable_array(vec)) {}
+        variable(variable_array &&vec);
 
         template<typename T>
-        variable(const std::vector<T> &vec) : m_value(std::in_place_type<variable_array>, vec.begin(), vec.end()) {}
+        variable(const std::vector<T> &vec) : variable(variable_array(vec.begin(), vec.end())) {}
 
         template<typename T>
-        variable(std::vector<T> &&vec) : m_value(std::in_place_type<variable_array>,
+        variable(std::vector<T> &&vec) : variable(variable_array(
             std::make_move_iterator(vec.begin()), std::make_move_iterator(vec.end())
-        ) {}
+        )) {}
 
         template<std::ranges::input_range T> requires std::ranges::enable_view<T>
-        variable(T range) : m_value(std::in_place_type<variable_array>, range.begin(), range.end()) {}
+        variable(T range) : variable(variable_array(range.begin(), range.end())) {}
+
+        variable(variable_ptr ptr) : m_ptr(ptr), m_type(variable_type::POINTER) {}
 
-        variable(variable_ptr ptr) : m_value(ptr) {}
-        
         variable_type type() const {
-            return m_value.enum_index();
+            return m_type;
         }
 
         size_t size() const;
@@ -106,24 +125,60 @@ namespace bls {
         bool is_number() const;
         bool is_array() const;
 
-        const std::string &as_string() const &;
-        std::string as_string() &&;
+        // Se la stringa (o gli elementi dell'array) puntano dentro a source,
+        // condivide il buffer di source oppure copia i caratteri,
+        // in modo che la variabile sopravviva alla distruzione di source
+        void detach_from(const variable &source);
+
+        // copia la stringa (o gli elementi dell'array) che puntano dentro a text
+        void detach_from_text(std::string_view text);
+
+        std::string as_string() const;
 
         variable_array &as_array();
         const variable_array &as_array() const;
 
-        const variable &deref() const &;
+        const variable &deref() const & {
+            if (m_type == variable_type::POINTER) {
+                return m_ptr->deref();
+            } else {
+                return *this;
+            }
+        }
+
         variable deref() &&;
 
+        // solo per i tipi scalari, nullptr se la variabile e' di un altro tipo
+        template<variable_type Type> const auto *get_if() const {
+            const auto &var = deref();
+            return var.m_type == Type ? &var.scalar<Type>() : nullptr;
+        }
+
+        // il testo delle stringhe, senza copiarlo. Gli altri tipi lanciano conversion_error,
+        // vanno convertiti con as_string o con la versione che salva il testo in storage
         string_state as_view() const;
+        string_state as_view(string_storage &storage) const;
+
         fixed_point as_number() const;
         int64_t as_int() const;
         double as_double() const;
         datetime as_date() const;
         variable_ptr as_pointer() const;
 
-        std::partial_ordering operator <=> (const variable &other) const;
-        
+        std::partial_ordering operator <=> (const variable &other) const {
+            const auto &lhs = deref();
+            const auto &rhs = other.deref();
+            // i confronti tra due stringhe o due interi sono i piu' frequenti, non passano dal doppio visit
+            if (lhs.m_type == rhs.m_type) {
+                if (lhs.m_type == variable_type::STRING) {
+                    return std::string_view(lhs.string_data(), lhs.m_size) <=> std::string_view(rhs.string_data(), rhs.m_size);
+                } else if (lhs.m_type == variable_type::INTEGER) {
+                    return lhs.m_int <=> rhs.m_int;
+                }
+            }
+            return compare(lhs, rhs);
+        }
+
         bool operator == (const variable &other) const {
             return 0 == *this <=> other;
         }
@@ -141,11 +196,157 @@ namespace bls {
         variable operator / (const variable &rhs) const;
 
     private:
-        mutable std::unique_ptr<std::string> m_str;
+        // caratteri di una stringa posseduta dalla variabile, seguono l'intestazione
+        struct string_buffer {
+            std::pmr::memory_resource *resource;
+            size_t capacity;
+            size_t refs = 1;
+
+            char *data() {
+                return reinterpret_cast<char *>(this + 1);
+            }
+
+            static string_buffer *create(std::string_view str, size_t capacity);
+            static void destroy(string_buffer *buf);
+        };
+
+        // sottostringa di un buffer condiviso
+        struct string_slice {
+            string_buffer *buffer;
+            size_t offset;
+            size_t refs = 1;
+        };
+
+        struct array_data;
+
+        using slice_box = util::arena_box<string_slice>;
+        using array_box = util::arena_box<array_data>;
+
+        static constexpr uint8_t flag_regex = 1 << 0;
+        static constexpr uint8_t flag_owned = 1 << 1;   // i caratteri sono in m_buffer
+        static constexpr uint8_t flag_slice = 1 << 2;   // i caratteri sono in m_slice
+
+        union {
+            int64_t m_int;
+            double m_double;
+            fixed_point m_number;
+            datetime m_date;
+            bool m_bool;
+            variable_ptr m_ptr;
+            const char *m_chars;
+            string_buffer *m_buffer;
+            slice_box *m_slice;
+            array_box *m_array;
+        };
+
+        uint32_t m_size = 0;
+        variable_type m_type : 8 = variable_type::NULLVAR;
+        uint8_t m_flags = 0;
+
+    private:
+        // la lunghezza delle stringhe e' salvata in 32 bit
+        static uint32_t checked_size(size_t size) {
+            if (size > std::numeric_limits<uint32_t>::max()) [[unlikely]] {
+                throw layout_error(intl::translate("STRING_TOO_LONG", size));
+            }
+            return uint32_t(size);
+        }
 
-        variable_variant m_value;
+        void set_string(std::string_view str, string_flags flags);
+        void append_string(std::string_view str);
+        void set_slice(string_buffer *buffer, std::string_view str);
+        void release_string() noexcept;
+
+        void unshare_array();
+
+        static std::partial_ordering compare(const variable &lhs, const variable &rhs);
+
+        void copy_from(const variable &other);
+        void move_from(variable &other) noexcept;
+        void destroy() noexcept;
+
+        const char *string_data() const {
+            if (m_flags & flag_owned) return m_buffer->data();
+            if (m_flags & flag_slice) return m_slice->value.buffer->data() + m_slice->value.offset;
+            return m_chars;
+        }
+
+        template<variable_type Type> const enums::enum_type_t<Type> &scalar() const;
+
+        template<variable_type Type> decltype(auto) get() const;
+
+        template<typename RetType, typename Visitor>
+        RetType visit(Visitor &&visitor) const;
+
+        template<typename Visitor>
+        decltype(auto) visit(Visitor &&visitor) const {
+            return visit<std::invoke_result_t<Visitor, std::monostate>>(std::forward<Visitor>(visitor));
+        }
+
+        template<typename RetType, typename Visitor>
+        static RetType visit(Visitor &&visitor, const variable &lhs, const variable &rhs) {
+            return lhs.visit<RetType>([&](const auto &lhs_value) {
+                return rhs.visit<RetType>([&](const auto &rhs_value) -> RetType {
+                    return std::invoke(visitor, lhs_value, rhs_value);
+                });
+            });
+        }
+
+        template<typename Visitor>
+        static decltype(auto) visit(Visitor &&visitor, const variable &lhs, const variable &rhs) {
+            return visit<std::invoke_result_t<Visitor, std::monostate, std::monostate>>(std::forward<Visitor>(visitor), lhs, rhs);
+        }
+    };
+
+    static_assert(sizeof(variable) == 16);
+
+    // il contatore non e' atomico, le variabili non vengono condivise tra thread
+    struct variable::array_data {
+        variable_array values;
+        size_t refs = 1;
     };
 
+    inline variable::variable(variable_array &&vec)
+        : m_array(array_box::create(std::move(vec)))
+        , m_type(variable_type::ARRAY) {}
+
+    template<variable_type Type> const enums::enum_type_t<Type> &variable::scalar() const {
+        if constexpr (Type == variable_type::NUMBER) {
+            return m_number;
+        } else if constexpr (Type == variable_type::BOOLEAN) {
+            return m_bool;
+        } else if constexpr (Type == variable_type::INTEGER) {
+            return m_int;
+        } else if constexpr (Type == variable_type::FLOAT) {
+            return m_double;
+        } else if constexpr (Type == variable_type::DATETIME) {
+            return m_date;
+        } else {
+            static_assert(Type == variable_type::NUMBER, "Tipo non scalare");
+        }
+    }
+
+    template<variable_type Type> decltype(auto) variable::get() const {
+        if constexpr (Type == variable_type::NULLVAR) {
+            return std::monostate{};
+        } else if constexpr (Type == variable_type::STRING) {
+            return string_state(std::string_view(string_data(), m_size), string_flags{bool(m_flags & flag_regex)});
+        } else if constexpr (Type == variable_type::ARRAY) {
+            return static_cast<const variable_array &>(m_array->value.values);
+        } else if constexpr (Type == variable_type::POINTER) {
+            return m_ptr;
+        } else {
+            return std::remove_cvref_t<decltype(scalar<Type>())>(scalar<Type>());
+        }
+    }
+
+    template<typename RetType, typename Visitor>
+    RetType variable::visit(Visitor &&visitor) const {
+        return enums::visit_enum<RetType>([&](enums::enum_tag_for<variable_type> auto tag) -> RetType {
+            return std::invoke(visitor, get<tag.value>());
+        }, m_type);
+    }
+
 }
 
 #endif
\ No newline at end of file
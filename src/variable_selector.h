@@ -9,7 +9,8 @@
 
 namespace bls {
 
-    using variable_map = std::map<std::string, variable, std::less<>>;
+    using variable_map = std::map<std::string, variable, std::less<>,
+        util::arena_allocator<std::pair<const std::string, variable>>>;
 
     class variable_selector {
     private:
@@ -72,8 +73,12 @@ namespace bls {
         }
 
         variable get_value() const {
-            auto it = m_current_map.find(m_name);
-            if (it == m_current_map.end()) return variable();
+            return get_value(m_current_map, m_name);
+        }
+
+        static variable get_value(const variable_map &map, std::string_view name) {
+            auto it = map.find(name);
+            if (it == map.end()) return variable();
             return it->second.as_pointer();
         }
     };
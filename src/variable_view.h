@@ -10,23 +10,23 @@ namespace bls {
     struct as_array_tag_t {};
     constexpr as_array_tag_t as_array_tag;
 
+    // Le viste possono essere spostate in memoria insieme allo stack che le contiene,
+    // per questo la vista di un singolo valore ne tiene una copia invece di un puntatore
     class variable_view {
     private:
+        variable m_value;
         std::span<const variable> m_span;
-        std::span<const variable>::iterator m_current;
+        size_t m_index = 0;
+        bool m_single = false;
 
     public:
-        variable_view(const variable &var) {
-            m_span = std::span(var.as_pointer(), 1);
-            m_current = m_span.begin();
-        }
+        variable_view(const variable &var) : m_value(var), m_single(true) {}
 
         variable_view(variable &&var) = delete;
 
         variable_view(const variable &var, as_array_tag_t) {
             if (var.is_array()) {
                 m_span = var.as_array();
-                m_current = m_span.begin();
             } else if (!var.is_null()) {
                 throw conversion_error(intl::translate("CANT_CONVERT_TYPE_TO_TYPE", intl::enum_label(var.type()), intl::enum_label(variable_type::ARRAY)));
             }
@@ -35,16 +35,17 @@ namespace bls {
         variable_view(variable &&var, as_array_tag_t) = delete;
 
         void nextview() {
-            ++m_current;
+            ++m_index;
         }
 
         bool ate() const {
-            return m_current >= m_span.end();
+            return m_index >= (m_single ? 1 : m_span.size());
         }
 
         variable view() const {
             if (ate()) return {};
-            return m_current->as_pointer();
+            if (m_single) return m_value;
+            return m_span[m_index].as_pointer();
         }
     };
 
@@ -0,0 +1,146 @@
+#include "bytecode_verifier.h"
+#include "parser.h"
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+// aggiunge una label in fondo al codice, i salti verso di essa vanno inseriti prima
+static command_node add_label(command_list &code) {
+    return code.insert(code.end(), make_command<opcode::LABEL>());
+}
+
+static layout_box make_box(std::string script) {
+    layout_box box{};
+    box.name = "test";
+    box.page = 1;
+    box.w = 1.0;
+    box.h = 1.0;
+    box.flags.set(box_flags::NOREAD);
+    box.script = std::move(script);
+    return box;
+}
+
+// il codice generato dal parser, con e senza le ottimizzazioni del reader, deve essere valido
+static void test_parser_output() {
+    layout_box_list layout;
+    layout.push_back(make_box(
+        "function f($x) { if ($x > 1) { return f($x - 1) + 1; } return 0; }\n"
+        "function g($x) { return $x * 2; }\n"
+        "a = f(5);\n"
+        "b = g(a);\n"
+        "foreach (split(\"1,2,3\", \",\")) { c[] = @; }\n"
+        "d = foreach (split(\"1,2\", \",\")) if (@ != \"2\") @;\n"
+        "with (\"abc\") { e = @; }\n"
+    ));
+
+    for (bool optimize : {false, true}) {
+        parser my_parser;
+        if (optimize) {
+            my_parser.add_flags(parser_flags::OPTIMIZE_LABELS);
+            my_parser.add_flags(parser_flags::TYPED_OPCODES);
+        }
+        auto code = my_parser(layout);
+        try {
+            auto depths = verify_bytecode(code);
+            check(depths.values > 0, "profondita' dello stack dei valori nulla");
+            check(depths.views > 0, "profondita' dello stack delle viste nulla");
+            check(depths.calls > 1, "profondita' delle chiamate non calcolata");
+        } catch (const std::exception &error) {
+            check(false, std::format("codice del parser rifiutato: {}", error.what()));
+        }
+    }
+}
+
+static void test_invalid_code() {
+    check_throws<layout_error>([] {
+        command_list code;
+        verify_bytecode(code);
+    }, "codice vuoto accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::VIEWPOP>());
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "VIEWPOP senza VIEWADD accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::PUSHINT>(int64_t(1)));
+        code.push_back(make_command<opcode::VIEWADD>());
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "RET con una vista aperta accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::PUSHINT>(int64_t(1)));
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "valore lasciato sullo stack all'uscita accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::STKDROP>(size_t(1)));
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "stack dei valori sotto zero accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::SETVAR>());
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "SETVAR senza variabile selezionata accettato");
+
+    check_throws<layout_error>([] {
+        // i due percorsi arrivano alla label con stack diversi
+        command_list code;
+        auto label = add_label(code);
+        code.insert(label, make_command<opcode::PUSHBOOL>(true));
+        code.insert(label, make_command<opcode::JZ>(label));
+        code.insert(label, make_command<opcode::PUSHINT>(int64_t(1)));
+        code.push_back(make_command<opcode::STKDROP>(size_t(0)));
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "stack sbilanciato in un punto di incontro accettato");
+
+    check_throws<layout_error>([] {
+        // la funzione ritorna con un numero di valori diverso a seconda del percorso
+        command_list code;
+        auto fun = add_label(code);
+        auto other = add_label(code);
+        code.insert(fun, make_command<opcode::JSR>(fun));
+        code.insert(fun, make_command<opcode::RET>());
+        code.insert(other, make_command<opcode::PUSHBOOL>(true));
+        code.insert(other, make_command<opcode::JZ>(other));
+        code.insert(other, make_command<opcode::PUSHINT>(int64_t(1)));
+        code.insert(other, make_command<opcode::RET>());
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "funzione con ritorni diversi accettata");
+
+    check_throws<layout_error>([] {
+        // salto verso un comando che non fa parte del codice
+        command_list other;
+        auto label = add_label(other);
+        command_list code;
+        code.push_back(make_command<opcode::JMP>(label));
+        code.push_back(make_command<opcode::RET>());
+        verify_bytecode(code);
+    }, "salto fuori dal codice accettato");
+
+    check_throws<layout_error>([] {
+        command_list code;
+        code.push_back(make_command<opcode::NOP>());
+        verify_bytecode(code);
+    }, "codice senza RET finale accettato");
+}
+
+int main() {
+    test_parser_output();
+    test_invalid_code();
+    return result();
+}
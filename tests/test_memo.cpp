@@ -0,0 +1,87 @@
+#include "reader.h"
+#include "parser.h"
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+static layout_box_list make_layout(std::string script) {
+    layout_box box{};
+    box.name = "test";
+    box.page = 1;
+    box.w = 1.0;
+    box.h = 1.0;
+    box.flags.set(box_flags::NOREAD);
+    box.script = std::move(script);
+
+    layout_box_list layout;
+    layout.push_back(std::move(box));
+    return layout;
+}
+
+// compila la funzione f chiamata una volta e cerca MEMOLOOKUP nel codice generato
+static bool has_memo(std::string function) {
+    stack_depths depths;
+    auto code = compile_layout(make_layout(function + "\na = f(2);\n"), depths);
+    return std::ranges::find(code, opcode::MEMOLOOKUP, &command_args::command) != code.end();
+}
+
+static std::string get_value(const reader &my_reader, std::string_view name) {
+    const auto &values = my_reader.get_values().front();
+    auto it = values.find(name);
+    return it == values.end() ? std::string{} : it->second.as_string();
+}
+
+// solo le funzioni pure che non vengono espanse inline usano la cache
+static void test_memo_functions() {
+    check(has_memo("function f($x) { if ($x > 1) { return 1; } return 0; }"), "funzione pura senza MEMOLOOKUP");
+    check(!has_memo("function f($x) { if ($x > 1) { return a; } return 0; }"), "MEMOLOOKUP in una funzione che legge i valori");
+    check(!has_memo("function f($x) { return $x * 2; }"), "MEMOLOOKUP in una funzione espansa inline");
+}
+
+// le chiamate ripetute vengono servite dalla cache: senza, fib(60) supererebbe il limite di istruzioni
+static void test_memo_hits() {
+    reader my_reader;
+    my_reader.add_layout(make_layout(
+        "function fib($n) { if ($n < 2) { return $n; } return fib($n - 1) + fib($n - 2); }\n"
+        "a = fib(60);\n"
+        "b = fib(60);\n"
+    ));
+    my_reader.set_limits(reader_limits{ .max_instructions = 100000 });
+    try {
+        my_reader.start();
+        check(get_value(my_reader, "a") == "1548008755920", "risultato di fib sbagliato");
+        check(get_value(my_reader, "b") == "1548008755920", "risultato in cache sbagliato");
+    } catch (const reader_limit_error &error) {
+        check(false, std::format("chiamate ripetute non servite dalla cache: {}", error.what()));
+    }
+}
+
+// argomenti diversi, o uguali ma con tipo o flag regex diversi, non trovano il risultato di un'altra chiamata
+static void test_memo_misses() {
+    reader my_reader;
+    my_reader.add_layout(make_layout(
+        "function cut($s, $from) { if ($s == \"\") { return \"\"; } return between($s, $from, \" \"); }\n"
+        "function kind($x) { if (isnull($x)) { return \"\"; } return type($x); }\n"
+        "a = cut(\"xa.b c\", \".\");\n"
+        "b = cut(\"xa.b c\", /./);\n"
+        "c = cut(\"xa.b c\", \".\");\n"
+        "d = cut(\"ya.b c\", \".\");\n"
+        "e = kind(1);\n"
+        "f = kind(\"1\");\n"
+    ));
+    my_reader.start();
+    check(get_value(my_reader, "a") == "b", "between con una stringa sbagliato");
+    check(get_value(my_reader, "b") == "a.b", "chiamata con una regex servita dalla cache della stringa");
+    check(get_value(my_reader, "c") == "b", "chiamata ripetuta servita dalla cache della regex");
+    check(get_value(my_reader, "d") == "b", "chiamata con un altro argomento sbagliata");
+    check(get_value(my_reader, "e") != get_value(my_reader, "f"), "argomenti di tipo diverso con lo stesso risultato");
+}
+
+int main() {
+    test_memo_functions();
+    test_memo_hits();
+    test_memo_misses();
+    return result();
+}
@@ -0,0 +1,115 @@
+#include "page_cache.h"
+
+#include <fstream>
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+namespace fs = std::filesystem;
+
+static util::sha256_digest document_digest(std::string_view content) {
+    return util::sha256{}.update(content).digest();
+}
+
+static std::vector<fs::path> entry_files(const fs::path &directory) {
+    std::vector<fs::path> ret;
+    for (const auto &entry : fs::directory_iterator(directory)) {
+        if (entry.path().extension() == ".bpc") {
+            ret.push_back(entry.path());
+        }
+    }
+    return ret;
+}
+
+// una voce viene ritrovata solo con la stessa chiave: documento, rettangolo e modalita'
+static void test_keys() {
+    temp_directory dir;
+    page_cache cache(dir.path());
+
+    auto doc = document_digest("documento");
+    const pdf_rect rect{0.1, 0.2, 0.3, 0.4, 1, read_mode::DEFAULT};
+    cache.store_text(doc, rect, "testo");
+
+    check(cache.load_text(doc, rect) == "testo", "voce salvata non ritrovata");
+
+    // la stessa cache aperta da un altro processo vede le stesse voci
+    check(page_cache(dir.path()).load_text(doc, rect) == "testo", "voce non condivisa tra due istanze");
+
+    check(!cache.load_text(document_digest("altro documento"), rect), "voce ritrovata con un altro documento");
+
+    auto other = rect;
+    other.page = 2;
+    check(!cache.load_text(doc, other), "voce ritrovata con un'altra pagina");
+
+    other = rect;
+    other.x = 0.11;
+    check(!cache.load_text(doc, other), "voce ritrovata con un altro rettangolo");
+
+    other = rect;
+    other.mode = read_mode::LAYOUT;
+    check(!cache.load_text(doc, other), "voce ritrovata con un'altra modalita'");
+
+    // il testo della pagina intera e i caratteri della stessa pagina sono voci diverse
+    cache.store_text(doc, pdf_rect{0.0, 0.0, 1.0, 1.0, 1, read_mode::RAW}, "pagina");
+    check(!cache.load_glyphs(doc, 1), "testo della pagina letto come caratteri");
+
+    std::vector<glyph> glyphs{{1.0f, 2.0f, 3.0f, 10.0f, U'a'}, {4.0f, 2.0f, 3.0f, 10.0f, U'b'}};
+    cache.store_glyphs(doc, 1, glyphs);
+    auto loaded = cache.load_glyphs(doc, 1);
+    check(loaded && loaded->size() == glyphs.size() && (*loaded)[1].code == U'b', "caratteri della pagina non ritrovati");
+    check(cache.load_text(doc, pdf_rect{0.0, 0.0, 1.0, 1.0, 1, read_mode::RAW}) == "pagina", "caratteri letti come testo della pagina");
+}
+
+// una voce troncata viene ignorata
+static void test_truncated() {
+    temp_directory dir;
+    page_cache cache(dir.path());
+
+    auto doc = document_digest("documento");
+    const pdf_rect rect{0.0, 0.0, 1.0, 1.0, 1, read_mode::DEFAULT};
+    cache.store_text(doc, rect, "testo abbastanza lungo");
+
+    auto files = entry_files(dir.path());
+    check(files.size() == 1, "numero di voci sbagliato");
+    if (files.size() == 1) {
+        fs::resize_file(files.front(), fs::file_size(files.front()) - 4);
+        check(!cache.load_text(doc, rect), "voce troncata ritrovata");
+    }
+}
+
+// oltre il limite vengono cancellate solo le voci, non gli altri file della cartella
+static void test_evict() {
+    temp_directory dir;
+    std::ofstream(dir.path() / "note.txt") << "non e' una voce";
+    std::ofstream(dir.path() / "abc.bpc") << "non e' una voce";
+
+    constexpr uint64_t max_bytes = 4096;
+    page_cache cache(dir.path(), max_bytes);
+
+    auto doc = document_digest("documento");
+    const std::string text(500, 'x');
+    for (int page = 1; page <= 20; ++page) {
+        cache.store_text(doc, pdf_rect{0.0, 0.0, 1.0, 1.0, page, read_mode::DEFAULT}, text);
+    }
+
+    uint64_t total = 0;
+    size_t entries = 0;
+    for (const auto &path : entry_files(dir.path())) {
+        if (path.filename() == "abc.bpc") continue;
+        total += fs::file_size(path);
+        ++entries;
+    }
+    check(entries > 0 && entries < 20, "voci non cancellate oltre il limite");
+    check(total <= max_bytes, "dimensione della cache oltre il limite");
+    check(fs::exists(dir.path() / "note.txt"), "cancellato un file che non e' una voce");
+    check(fs::exists(dir.path() / "abc.bpc"), "cancellato un file con l'estensione delle voci");
+}
+
+int main() {
+    test_keys();
+    test_truncated();
+    test_evict();
+    return result();
+}
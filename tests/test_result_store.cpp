@@ -0,0 +1,78 @@
+#include "result_store.h"
+
+#include <fstream>
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+namespace fs = std::filesystem;
+
+// scrive un layout con un solo box che esegue script
+static void write_layout(const fs::path &filename, std::string_view script) {
+    std::ofstream output(filename, std::ios::binary);
+    output << "### Bill Layout Script\n"
+        "### Box test\n"
+        "### Flags NOREAD\n"
+        "### Page 1\n"
+        "### Rect 0 0 1 1\n"
+        "### Script\n"
+        << script << "\n"
+        "### End Script\n"
+        "### End Box\n";
+}
+
+// l'hash del programma cambia quando cambia uno dei layout, anche importato, e non quando viene riletto
+static void test_digest() {
+    temp_directory dir;
+    auto main_layout = dir.path() / "main.bls";
+    auto imported_layout = dir.path() / "imported.bls";
+    write_layout(main_layout, "import \"imported\";\na = 1;");
+    write_layout(imported_layout, "b = 2;");
+
+    result_store store(dir.path() / "store");
+    auto first = store.digest(main_layout);
+    check(first.files.size() == 2, "layout importato non incluso nell'hash");
+    check(!first.reads_doc_filename && !first.reads_files, "flag del layout impostati senza chiamate");
+
+    auto cached = store.digest(main_layout);
+    check(cached.program == first.program, "hash del programma cambiato senza modifiche");
+    check(cached.program == digest_layout(main_layout).program, "hash salvato diverso da quello calcolato");
+
+    write_layout(imported_layout, "b = 20;");
+    auto changed = store.digest(main_layout);
+    check(changed.program != first.program, "hash non aggiornato dopo la modifica del layout importato");
+    check(changed.program == digest_layout(main_layout).program, "hash salvato non ricalcolato");
+
+    write_layout(main_layout, "a = doc_filename();\nb = readfile(\"x.txt\");");
+    auto flags = store.digest(main_layout);
+    check(flags.reads_doc_filename, "chiamata a doc_filename non rilevata");
+    check(flags.reads_files, "chiamata a readfile non rilevata");
+    check(flags.files.size() == 1, "import rimosso ancora incluso nell'hash");
+}
+
+// una voce salvata con un altro programma non viene restituita e viene cancellata
+static void test_entries() {
+    temp_directory dir;
+    result_store store(dir.path());
+
+    auto key = util::sha256{}.update("chiave").digest();
+    auto program = util::sha256{}.update("programma").digest();
+    auto other_program = util::sha256{}.update("altro programma").digest();
+
+    check(!store.load(key, program), "voce trovata prima del salvataggio");
+
+    store.store(key, program, "{\"values\":[]}");
+    check(store.load(key, program) == "{\"values\":[]}", "voce salvata non ritrovata");
+    check(!store.load(util::sha256{}.update("altra chiave").digest(), program), "voce trovata con un'altra chiave");
+
+    check(!store.load(key, other_program), "voce trovata con un altro programma");
+    check(!store.load(key, program), "voce di un altro programma non cancellata");
+}
+
+int main() {
+    test_digest();
+    test_entries();
+    return result();
+}
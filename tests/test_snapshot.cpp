@@ -0,0 +1,100 @@
+#include "document_snapshot.h"
+#include "layout.h"
+#include "reader.h"
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+// documento finto, il testo dipende solo dal rettangolo letto.
+// Contiene anche righe che sembrano intestazioni della registrazione
+class fake_document : public document_source {
+public:
+    std::filesystem::path filename() const override {
+        return "fattura.pdf";
+    }
+
+    int num_pages() const override {
+        return 2;
+    }
+
+    std::string get_text(const pdf_rect &rect, const cancel_token & = {}) const override {
+        return std::format("pagina {} {}\n### End Snapshot\n{:.3f} {:.3f} {:.3f} {:.3f}\n",
+            rect.page, enums::to_string(rect.mode), rect.x, rect.y, rect.w, rect.h);
+    }
+};
+
+static layout_box make_box(std::string name, pdf_rect rect, std::string script, std::string spacers = {}) {
+    layout_box box{};
+    static_cast<pdf_rect &>(box) = rect;
+    box.name = std::move(name);
+    box.script = std::move(script);
+    box.spacers = std::move(spacers);
+    return box;
+}
+
+static layout_box_list make_layout() {
+    layout_box_list layout;
+    layout.push_back(make_box("testo", pdf_rect{0.1, 0.2, 0.3, 0.4, 1, read_mode::DEFAULT},
+        "a = @;\n"
+        "nome = doc_filename();\n"
+        "pagine = doc_numpages();\n"));
+    layout.push_back(make_box("raw", pdf_rect{0.5, 0.5, 0.25, 0.25, 2, read_mode::RAW},
+        "b = singleline(@);\n", "top + 0.125;"));
+    auto &page = layout.emplace_back(make_box("pagina", pdf_rect{0.0, 0.0, 0.0, 0.0, 2, read_mode::LAYOUT},
+        "c = @;\n"));
+    page.flags.set(box_flags::PAGE);
+    return layout;
+}
+
+// i valori di tutte le tabelle, uno per riga
+static std::string dump_values(const reader &my_reader) {
+    std::string ret;
+    for (const auto &table : my_reader.get_values()) {
+        for (const auto &[name, value] : table) {
+            ret += std::format("{} = {}\n", name, value.as_string());
+        }
+        ret += "---\n";
+    }
+    return ret;
+}
+
+// la lettura della registrazione deve dare gli stessi valori della lettura del documento
+static void test_replay() {
+    temp_directory dir;
+    auto snapshot_file = dir.path() / "fattura.snapshot";
+    auto layout = make_layout();
+
+    fake_document doc;
+    recording_document recording(doc);
+    reader live_reader;
+    live_reader.set_document(recording);
+    live_reader.add_layout(layout);
+    live_reader.start();
+    recording.save_file(snapshot_file);
+
+    snapshot_document snapshot(snapshot_file);
+    check(snapshot.filename() == doc.filename(), "nome del documento non registrato");
+    check(snapshot.num_pages() == doc.num_pages(), "numero di pagine non registrato");
+
+    reader replay_reader;
+    replay_reader.set_document(snapshot);
+    replay_reader.add_layout(layout);
+    replay_reader.start();
+
+    auto live_values = dump_values(live_reader);
+    auto replay_values = dump_values(replay_reader);
+    check(!live_values.empty() && live_values == replay_values,
+        std::format("valori diversi dalla lettura del documento:\n{}\n{}", live_values, replay_values));
+
+    // un rettangolo non registrato non puo' essere letto
+    check_throws<layout_error>([&] {
+        snapshot.get_text(pdf_rect{0.9, 0.9, 0.1, 0.1, 1, read_mode::DEFAULT});
+    }, "letto un rettangolo non registrato");
+}
+
+int main() {
+    test_replay();
+    return result();
+}
@@ -0,0 +1,97 @@
+#include "parser.h"
+
+#include "test_utils.h"
+
+using namespace bls;
+using namespace bls::test;
+
+static size_t count_opcode(const command_list &code, opcode cmd) {
+    return std::ranges::count(code, cmd, &command_args::command);
+}
+
+static size_t count_calls(const command_list &code, std::string_view fun_name) {
+    return std::ranges::count_if(code, [&](const command_args &line) {
+        return line.command() == opcode::CALL && line.get_args<opcode::CALL>()->first == fun_name;
+    });
+}
+
+static command_list parse_box(std::string script, std::string spacers = {}) {
+    layout_box box{};
+    box.name = "test";
+    box.page = 2;
+    box.x = 0.1;
+    box.y = 0.2;
+    box.w = 0.3;
+    box.h = 0.4;
+    box.script = std::move(script);
+    box.spacers = std::move(spacers);
+
+    layout_box_list layout;
+    layout.push_back(std::move(box));
+    return parser{}(layout);
+}
+
+// il rettangolo del box viene impostato con una sola istruzione, gli spacer lo spostano dopo
+static void test_setbox() {
+    auto code = parse_box("a = @;");
+    check(count_opcode(code, opcode::SETBOX) == 1, "SETBOX non generato");
+    check(count_opcode(code, opcode::MVBOX) == 0, "MVBOX generato senza spacer");
+    check(count_opcode(code, opcode::PUSHDOUBLE) == 0, "coordinate del box caricate sullo stack");
+
+    auto it = std::ranges::find(code, opcode::SETBOX, &command_args::command);
+    if (it != code.end()) {
+        check(it->get_args<opcode::SETBOX>() == pdf_rect{0.1, 0.2, 0.3, 0.4, 2}, "rettangolo di SETBOX diverso da quello del box");
+    }
+
+    auto moved = parse_box("a = @;", "top + 0.1;");
+    check(count_opcode(moved, opcode::SETBOX) == 1, "SETBOX non generato con gli spacer");
+    check(count_opcode(moved, opcode::MVBOX) == 1, "spacer non applicato");
+}
+
+// le letture di una variabile per nome non selezionano la variabile
+static void test_named_reads() {
+    auto code = parse_box(
+        "$x = 1;\n"
+        "global g = 2;\n"
+        "a = $x;\n"
+        "b = global g;\n"
+        "c = a;\n"
+    );
+    check(count_opcode(code, opcode::PUSHLOCALNAMED) == 1, "lettura di una variabile locale non fusa");
+    check(count_opcode(code, opcode::PUSHGLOBALNAMED) == 1, "lettura di una variabile globale non fusa");
+    check(count_opcode(code, opcode::PUSHVARNAMED) == 1, "lettura di un valore non fusa");
+    check(count_opcode(code, opcode::PUSHVAR) == 0, "PUSHVAR generato per una lettura per nome");
+}
+
+// CALL porta il numero degli argomenti, i confronti seguiti da un salto diventano un salto solo
+static void test_calls_and_jumps() {
+    auto code = parse_box(
+        "a = substr(@, 1, 2);\n"
+        "if (a == \"x\") { b = 1; }\n"
+        "if (a < \"x\") { c = 1; }\n"
+        "if (!(a != \"x\")) { d = 1; }\n"
+    );
+
+    auto it = std::ranges::find_if(code, [](const command_args &line) {
+        return line.command() == opcode::CALL && line.get_args<opcode::CALL>()->first == "substr";
+    });
+    check(it != code.end(), "chiamata a substr non trovata");
+    if (it != code.end()) {
+        check(it->get_args<opcode::CALL>().numargs == 3, "numero di argomenti di CALL sbagliato");
+    }
+
+    check(count_opcode(code, opcode::JZEQ) == 1, "eq seguito da JZ non fuso");
+    check(count_opcode(code, opcode::JZLT) == 1, "lt seguito da JZ non fuso");
+    check(count_opcode(code, opcode::JNZ) == 1, "not seguito da JZ non fuso");
+    check(count_opcode(code, opcode::JZ) == 0, "JZ generato dopo un confronto");
+    check(count_calls(code, "eq") == 0 && count_calls(code, "lt") == 0 && count_calls(code, "not") == 0,
+        "confronto chiamato prima del salto");
+    check(count_calls(code, "neq") == 1, "confronto dentro not fuso con il salto");
+}
+
+int main() {
+    test_setbox();
+    test_named_reads();
+    test_calls_and_jumps();
+    return result();
+}
@@ -0,0 +1,67 @@
+#ifndef __TEST_UTILS_H__
+#define __TEST_UTILS_H__
+
+#include <iostream>
+#include <string_view>
+#include <source_location>
+#include <filesystem>
+#include <random>
+
+#include "utils/format.h"
+
+namespace bls::test {
+
+    // numero di controlli falliti, il main del test lo ritorna come codice di uscita
+    inline int failures = 0;
+
+    inline void check(bool condition, std::string_view description, std::source_location loc = std::source_location::current()) {
+        if (!condition) {
+            std::cerr << loc.file_name() << ':' << loc.line() << ": " << description << std::endl;
+            ++failures;
+        }
+    }
+
+    // fun deve lanciare un'eccezione di tipo Exception
+    template<typename Exception, typename Function>
+    void check_throws(Function &&fun, std::string_view description, std::source_location loc = std::source_location::current()) {
+        try {
+            fun();
+        } catch (const Exception &) {
+            return;
+        } catch (const std::exception &error) {
+            check(false, std::format("{}: {}", description, error.what()), loc);
+            return;
+        }
+        check(false, description, loc);
+    }
+
+    // cartella temporanea vuota, cancellata con tutto il contenuto alla distruzione
+    class temp_directory {
+    public:
+        temp_directory() {
+            std::random_device rd;
+            m_path = std::filesystem::temp_directory_path() / std::format("bls_test_{:08x}{:08x}", rd(), rd());
+            std::filesystem::create_directories(m_path);
+        }
+
+        ~temp_directory() {
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+
+        temp_directory(const temp_directory &) = delete;
+        temp_directory &operator = (const temp_directory &) = delete;
+
+        const std::filesystem::path &path() const { return m_path; }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+    inline int result() {
+        return failures == 0 ? 0 : 1;
+    }
+
+}
+
+#endif